@@ -7,9 +7,13 @@
  * Varies: initial altitude (h0), drag coefficent (Cd), area-to-mass (A2M)
  * Output per run: lifetime (days) until Altitude < 122 km, or until MaxDays cap.
  *
- * Build:   mpicxx -O3 -std=c++17 -o montecarlo_wrapper montecarlo_wrapper.cpp
+ * Build:   mpicxx -O3 -std=c++17 -I<Sim-parallel>/Train-sim -o montecarlo_wrapper montecarlo_wrapper.cpp
  * Run MC:  mpirun -np 4 ./montecarlo_wrapper
  *
+ * The random numbers come from philox.h in Train-sim.  When the wrapper is copied into the GMAT install to run
+ * next to ../GmatConsole, point -I at the Train-sim directory of this repository as above, or copy
+ * Train-sim/philox.h next to the wrapper and build with -I. instead.
+ *
  * Options:
  *   --n = Total number of Monte Carlo simulations (default: 100) 
  *   --mass = Satellite mass in kg (default: 200.0)
@@ -31,6 +35,8 @@
 #include <chrono>
 #include <filesystem>
 
+#include "philox.h"
+
 #define GMAT_EXECUTABLE "../GmatConsole"
 #define GLOBAL_SEED 1234
 
@@ -53,14 +59,14 @@ struct Result {
 /******************************************
            Monte Carlo Generators
 *******************************************/
-static inline double urand() {
-    return (rand() / (double)RAND_MAX); // [0,1.0)
-}
-
-void generateRandomLEO(Trial& t) {
-    t.h0_km = 500.0 + (500.0 * urand());   // 500..1000 km 
-    t.Cd    = 2.0   + (0.6   * urand());   // 2.0..2.6
-    t.A2M   = 0.005 + (0.045 * urand());   // 0.005..0.05 m^2/kg
+// Trial id draws from its own Philox stream of GLOBAL_SEED, so a trial is the same whichever rank runs it
+void generateRandomLEO(Trial& t, int id) {
+    double u[3];
+    philox_uniform_fill(GLOBAL_SEED, (uint64_t)id, 0, u, 3);  // (0,1)
+
+    t.h0_km = 500.0 + (500.0 * u[0]);   // 500..1000 km 
+    t.Cd    = 2.0   + (0.6   * u[1]);   // 2.0..2.6
+    t.A2M   = 0.005 + (0.045 * u[2]);   // 0.005..0.05 m^2/kg
 }
 
 /******************************************
@@ -231,8 +237,7 @@ void runMonteCarloDecay(int numSimulations, int rank, int size, double massKg, d
 
     // Loops through each trial assigned to current rank
     for (int i = rank; i < numSimulations; i += size) {
-        srand(GLOBAL_SEED + i);
-        Trial t; generateRandomLEO(t);              
+        Trial t; generateRandomLEO(t, i);
         Result r = runSingleTrajectory(i, t, massKg, maxDaysCap);
         // If successful, print and check for best
         if (r.ok) {
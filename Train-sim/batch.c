@@ -0,0 +1,154 @@
+#include <math.h>
+#include <omp.h>
+
+#include "batch.h"
+#include "rules.h"
+
+// Vector width for sincos_batch - AVX-512 and AVX2 use FMA intrinsics, anything else runs the same recurrence
+// one lane at a time
+//
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#define LANES (8)
+typedef __m512d vdouble;
+#define VSET1(x) _mm512_set1_pd(x)
+#define VLOAD(p) _mm512_loadu_pd(p)
+#define VSTORE(p, v) _mm512_storeu_pd((p), (v))
+#define VMUL(a, b) _mm512_mul_pd((a), (b))
+#define VFMADD(a, b, c) _mm512_fmadd_pd((a), (b), (c))
+#define VFMSUB(a, b, c) _mm512_fmsub_pd((a), (b), (c))
+
+#elif defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define LANES (4)
+typedef __m256d vdouble;
+#define VSET1(x) _mm256_set1_pd(x)
+#define VLOAD(p) _mm256_loadu_pd(p)
+#define VSTORE(p, v) _mm256_storeu_pd((p), (v))
+#define VMUL(a, b) _mm256_mul_pd((a), (b))
+#define VFMADD(a, b, c) _mm256_fmadd_pd((a), (b), (c))
+#define VFMSUB(a, b, c) _mm256_fmsub_pd((a), (b), (c))
+
+#else
+#define LANES (1)
+typedef double vdouble;
+#define VSET1(x) (x)
+#define VLOAD(p) (*(p))
+#define VSTORE(p, v) (*(p) = (v))
+#define VMUL(a, b) ((a) * (b))
+#define VFMADD(a, b, c) ((a) * (b) + (c))
+#define VFMSUB(a, b, c) ((a) * (b) - (c))
+#endif
+
+// Samples between exact libm seeds - each rotation adds about an ulp of error, so this bounds the drift to
+// RESEED/LANES ulps while keeping libm to 2 calls per RESEED samples
+#define RESEED (256)
+
+
+// Angle addition recurrence
+//
+// With lane j of the vector at angle x+j*dx, one rotation by LANES*dx advances every lane by LANES samples:
+//
+//     sin(x + h) = sin(x)*cos(h) + cos(x)*sin(h)
+//     cos(x + h) = cos(x)*cos(h) - sin(x)*sin(h)
+//
+// The lanes are seeded from an exact sin/cos of the block start every RESEED samples.
+//
+void sincos_batch(double x0, double dx, unsigned long n, double *s, double *c)
+{
+    double lane_s[LANES], lane_c[LANES], tail_s[LANES], tail_c[LANES];
+    double step_s = sin(LANES*dx), step_c = cos(LANES*dx), x, s0, c0;
+    unsigned long base, count, k;
+    vdouble vs, vc, vnext, vls, vlc, vss, vsc, vs0, vc0;
+    int lane;
+
+    for(lane=0; lane < LANES; lane++)
+    {
+        lane_s[lane] = sin(lane*dx);
+        lane_c[lane] = cos(lane*dx);
+    }
+
+    vls = VLOAD(lane_s); vlc = VLOAD(lane_c);
+    vss = VSET1(step_s); vsc = VSET1(step_c);
+
+    for(base=0; base < n; base += RESEED)
+    {
+        count = (n - base < RESEED) ? n - base : RESEED;
+
+        x = x0 + (double)base*dx;
+        s0 = sin(x); c0 = cos(x);
+
+        // lane j = rotation of the block start by j*dx
+        vs0 = VSET1(s0); vc0 = VSET1(c0);
+        vs = VFMADD(vs0, vlc, VMUL(vc0, vls));
+        vc = VFMSUB(vc0, vlc, VMUL(vs0, vls));
+
+        for(k=0; k + LANES <= count; k += LANES)
+        {
+            VSTORE(&s[base+k], vs);
+            VSTORE(&c[base+k], vc);
+
+            vnext = VFMADD(vs, vsc, VMUL(vc, vss));
+            vc = VFMSUB(vc, vsc, VMUL(vs, vss));
+            vs = vnext;
+        }
+
+        if(k < count)
+        {
+            VSTORE(tail_s, vs);
+            VSTORE(tail_c, vc);
+
+            for(lane=0; k < count; k++, lane++)
+            {
+                s[base+k] = tail_s[lane];
+                c[base+k] = tail_c[lane];
+            }
+        }
+    }
+}
+
+
+// Weighted sum of the interior nodes first..last-1 of the grid a + i*g, a block of BATCH_SIZE at a time
+static double batch_interior(int integrator, double a, double g, unsigned long first, unsigned long last, batch_func funct)
+{
+    double sum = 0.0, buffer[BATCH_SIZE];
+    unsigned long idx, count, k;
+
+    for(idx=first; idx < last; idx += count)
+    {
+        count = (last - idx < BATCH_SIZE) ? last - idx : BATCH_SIZE;
+        funct(a + (double)idx*g, g, count, buffer);
+
+        for(k=0; k < count; k++)
+            sum += rule_weight(integrator, idx + k) * buffer[k];
+    }
+
+    return sum;
+}
+
+
+double Local_Batch(int integrator, double a, double b, unsigned long n, batch_func funct, partition_schedule_t schedule)
+{
+    static partition_t part;
+    const rule_t *rule = rule_get(integrator);
+    unsigned long N = rule_intervals(integrator, n), first, last, claimed=0;
+    double g, sum = 0.0, fa, fb;
+
+    if(n == 0) return 0.0;
+
+    g = (b - a) / (double)N;
+
+    if(omp_get_thread_num() == 0)
+    {
+        funct(a, g, 1, &fa);
+        funct(b, g, 1, &fb);
+        sum = rule->w_a*fa + rule->w_b*fb;
+    }
+
+    partition_begin(&part, 1, N, schedule);
+
+    while(partition_next(&part, &claimed, &first, &last))
+        sum += batch_interior(integrator, a, g, first, last, funct);
+
+    return rule->factor * g * sum;
+}
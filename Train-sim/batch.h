@@ -0,0 +1,31 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "partition.h"
+
+// Batched evaluation of the analytic oracles on uniform time grids
+//
+// ex3_accel and ex3_vel cost one libm sin or cos call per evaluation, and RK4 makes four of them per step.  The
+// batch path instead fills blocks of samples at a time: sincos_batch() generates sin and cos along a uniform grid
+// with the angle addition recurrence, vectorized with AVX-512 or AVX2 when compiled for them (scalar otherwise),
+// so the integrators are bound by multiply-adds rather than by libm calls.
+//
+// A batch integrand fills out[k] = f(t0 + k*dt) for k=0..n-1.
+//
+typedef void batch_func(double t0, double dt, unsigned long n, double *out);
+
+// Samples per block handed to a batch_func by Local_Batch
+#define BATCH_SIZE (1024)
+
+// sin(x0 + k*dx) and cos(x0 + k*dx) for k=0..n-1
+void sincos_batch(double x0, double dx, unsigned long n, double *s, double *c);
+
+// This thread's share of the integral over [a, b] in n steps with a batch integrand, on the same node grid and
+// with the same weights and schedule as Local_Rule (see rules.h) - the interior nodes are evaluated in blocks of
+// BATCH_SIZE, so RK4 samples its half-step grid once
+//
+// integrator is the drivers' 0=Riemann, 1=Trap, 2=Simpson, 3=RK4
+//
+double Local_Batch(int integrator, double a, double b, unsigned long n, batch_func funct, partition_schedule_t schedule);
+
+#endif
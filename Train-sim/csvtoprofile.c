@@ -0,0 +1,502 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <omp.h>
+
+#include "profile.h"
+#include "simopts.h"
+
+// Convert a CSV route file to a binary train profile (see profile.h)
+//
+// Unlike csvtostatic, which reads a fixed 1801 values one fscanf at a time into a C initializer, this handles
+// any number of rows and several columns.  The CSV is memory-mapped and split into one chunk per thread at line
+// boundaries, each chunk's rows are counted, and then each thread parses its chunk straight into the mapped
+// output columns at its row offset - so a 100M row file is just two passes over memory.
+//
+// Each CSV column (in order) is named with --columns, e.g. --columns=accel,grade,speed for acceleration in
+// m/s^2, grade in percent, and speed limit in m/s.  Extra CSV columns are ignored.  A first line that does not
+// start with a number is taken to be a header and skipped, as are blank lines.
+//
+// For every data column a slope column (x[i+1]-x[i])*rate is also written, so the simulators can interpolate
+// without recomputing it, and the summary statistics of all columns are printed.
+//
+// Logger data at irregular or mixed rates keeps its timestamps in a time column (seconds, strictly increasing):
+// the slopes are then per second of the time between the samples, --rate is not used, and the header has the mean
+// rate and the first time.
+//
+//     ./csvtoprofile Ex4-Acceleration-Profile.csv ex4.bin
+//     ./csvtoprofile route.csv route.bin --columns=accel,grade,speed --rate=10 --threads=8
+//     ./csvtoprofile logger.csv logger.bin --columns=time,accel,speed
+//
+
+#define MAX_CSV_COLUMNS (PROFILE_MAX_COLUMNS/2)
+
+struct column_name
+{
+    const char *name;
+    uint32_t kind;
+    uint32_t units;
+};
+
+struct column_name column_names[]=
+{
+    {"accel", PROFILE_COL_ACCEL, PROFILE_UNITS_MPS2},
+    {"grade", PROFILE_COL_GRADE, PROFILE_UNITS_PERCENT},
+    {"speed", PROFILE_COL_SPEED_LIMIT, PROFILE_UNITS_MPS},
+    {"time", PROFILE_COL_TIME, PROFILE_UNITS_SECONDS}
+};
+#define NUM_COLUMN_NAMES (sizeof(column_names)/sizeof(struct column_name))
+
+const char *kind_name(uint32_t kind);
+int parse_columns(const char *list, uint32_t *kinds, uint32_t *units);
+uint64_t count_rows(const char *p, const char *end);
+const char *parse_rows(const char *p, const char *end, int ncols, double **column, uint64_t row);
+const char *parse_double(const char *p, const char *end, double *value);
+
+
+int main(int argc, char *argv[])
+{
+    char *posv[argc+1];
+    int posc = sim_positional(argc, argv, posv);
+    const char *opt;
+    uint32_t kinds[PROFILE_MAX_COLUMNS], units[PROFILE_MAX_COLUMNS];
+    int ncols, nslopes, col, chunk, thread_count=omp_get_max_threads();
+    double rate=1.0;
+    struct stat st;
+    const char *data, *end, *p;
+    uint64_t rows, idx;
+    uint64_t *chunk_rows;
+    const char **chunk_start;
+    double *column[PROFILE_MAX_COLUMNS], *time_column=NULL;
+    profile_t prof;
+    struct timespec start, stop;
+    int fd, errors=0;
+
+    if(posc != 3)
+    {
+        printf("Use: csvtoprofile input.csv output.bin [--columns=time,accel,grade,speed] [--rate=Hz] [--threads=N]\n");
+        exit(-1);
+    }
+
+    if((opt = sim_option(argc, argv, "rate")) != NULL) sscanf(opt, "%lf", &rate);
+    if((opt = sim_option(argc, argv, "threads")) != NULL) sscanf(opt, "%d", &thread_count);
+    if((opt = sim_option(argc, argv, "columns")) == NULL) opt = "accel";
+
+    if((ncols = parse_columns(opt, kinds, units)) <= 0)
+        exit(-1);
+
+    if(thread_count < 1)
+    {
+        printf("Error: --threads=%d, need at least 1\n", thread_count);
+        exit(-1);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if((fd = open(posv[1], O_RDONLY)) < 0)
+    {
+        printf("Error opening %s: %s\n", posv[1], strerror(errno));
+        exit(-1);
+    }
+
+    if((fstat(fd, &st) < 0) || (st.st_size == 0))
+    {
+        printf("Error: %s is empty\n", posv[1]);
+        exit(-1);
+    }
+
+    if((data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+    {
+        printf("Error mapping %s: %s\n", posv[1], strerror(errno));
+        exit(-1);
+    }
+
+    madvise((void *)data, st.st_size, MADV_SEQUENTIAL);
+    end = data + st.st_size;
+
+    // Skip a header line of column names
+    p = data;
+    while((p < end) && ((*p == ' ') || (*p == '\t'))) p++;
+
+    if((p < end) && (strchr("+-.0123456789\r\n", *p) == NULL))
+    {
+        p = memchr(p, '\n', end - p);
+        p = (p == NULL) ? end : p+1;
+    }
+
+    // Split at line boundaries, one chunk per thread
+    chunk_start = malloc(sizeof(char *) * (thread_count+1));
+    chunk_rows = malloc(sizeof(uint64_t) * (thread_count+1));
+
+    if((chunk_start == NULL) || (chunk_rows == NULL))
+    {
+        printf("Error: could not allocate the chunks for %d threads\n", thread_count);
+        exit(-1);
+    }
+
+    chunk_start[0] = p;
+    chunk_start[thread_count] = end;
+
+    for(chunk=1; chunk < thread_count; chunk++)
+    {
+        const char *split = p + (uint64_t)(end - p) * chunk / thread_count;
+
+        if(split < chunk_start[chunk-1]) split = chunk_start[chunk-1];
+
+        split = memchr(split, '\n', end - split);
+        chunk_start[chunk] = (split == NULL) ? end : split+1;
+    }
+
+    // Pass 1: rows in each chunk, then the starting row of each chunk
+    #pragma omp parallel for num_threads(thread_count) schedule(static, 1)
+    for(chunk=0; chunk < thread_count; chunk++)
+        chunk_rows[chunk+1] = count_rows(chunk_start[chunk], chunk_start[chunk+1]);
+
+    chunk_rows[0] = 0;
+    for(chunk=1; chunk <= thread_count; chunk++)
+        chunk_rows[chunk] += chunk_rows[chunk-1];
+
+    rows = chunk_rows[thread_count];
+
+    if(rows < 2)
+    {
+        printf("Error: %s has %lu rows, need at least 2\n", posv[1], (unsigned long)rows);
+        exit(-1);
+    }
+
+    // Data columns first, then a slope column for each but the time
+    for(col=0, nslopes=0; col < ncols; col++)
+    {
+        if(kinds[col] == PROFILE_COL_TIME)
+            continue;
+
+        kinds[ncols+nslopes] = PROFILE_SLOPE_OF(kinds[col]);
+        units[ncols+nslopes] = units[col] | PROFILE_UNITS_PER_SECOND;
+        nslopes++;
+    }
+
+    if(profile_create(posv[2], &prof, ncols+nslopes, kinds, units, rows, rate) < 0)
+        exit(-1);
+
+    for(col=0; col < ncols+nslopes; col++)
+        column[col] = profile_column(&prof, kinds[col]);
+
+    time_column = profile_column(&prof, PROFILE_COL_TIME);
+
+    // Pass 2: parse each chunk directly into the output columns
+    #pragma omp parallel for num_threads(thread_count) schedule(static, 1) reduction(+:errors)
+    for(chunk=0; chunk < thread_count; chunk++)
+    {
+        const char *bad = parse_rows(chunk_start[chunk], chunk_start[chunk+1], ncols, column, chunk_rows[chunk]);
+
+        if(bad != NULL)
+        {
+            const char *eol = memchr(bad, '\n', chunk_start[chunk+1] - bad);
+            int len = (eol == NULL) ? (int)(chunk_start[chunk+1] - bad) : (int)(eol - bad);
+
+            printf("Error: could not parse %d columns from \"%.*s\"\n", ncols, (len > 80) ? 80 : len, bad);
+            errors++;
+        }
+    }
+
+    if(errors)
+    {
+        profile_close(&prof);
+        unlink(posv[2]);
+        exit(-1);
+    }
+
+    // Sample times must increase, and give the mean rate
+    if(time_column != NULL)
+    {
+        #pragma omp parallel for num_threads(thread_count) reduction(+:errors)
+        for(idx=0; idx < rows-1; idx++)
+            errors += !(time_column[idx+1] > time_column[idx]);
+
+        if(errors)
+        {
+            printf("Error: the time column of %s does not increase, %d rows out of order\n", posv[1], errors);
+            profile_close(&prof);
+            unlink(posv[2]);
+            exit(-1);
+        }
+
+        rate = (double)(rows-1) / (time_column[rows-1] - time_column[0]);
+        prof.header->sample_rate = rate;
+    }
+
+    // Per-interval slopes, with units per second rather than per sample
+    for(col=0, nslopes=0; col < ncols; col++)
+    {
+        const double *x = column[col];
+        double *slope;
+
+        if(kinds[col] == PROFILE_COL_TIME)
+            continue;
+
+        slope = column[ncols+nslopes++];
+
+        if(time_column != NULL)
+        {
+            #pragma omp parallel for num_threads(thread_count)
+            for(idx=0; idx < rows-1; idx++)
+                slope[idx] = (x[idx+1] - x[idx]) / (time_column[idx+1] - time_column[idx]);
+        }
+        else
+        {
+            #pragma omp parallel for num_threads(thread_count)
+            for(idx=0; idx < rows-1; idx++)
+                slope[idx] = (x[idx+1] - x[idx]) * rate;
+        }
+
+        slope[rows-1] = 0.0;
+    }
+
+    if(profile_finish(&prof) < 0)
+        exit(-1);
+
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+
+    printf("Converted %s to %s: %lu rows at %s%lf Hz (%lf seconds of route) with %d threads in %lf seconds, %lf MB/s\n",
+           posv[1], posv[2], (unsigned long)rows, (time_column != NULL) ? "a mean " : "", rate, (double)(rows-1)/rate, thread_count,
+           (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1000000000.0,
+           (double)st.st_size / 1000000.0 /
+           ((stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1000000000.0));
+
+    for(col=0; col < ncols+nslopes; col++)
+    {
+        profile_column_t *c = &prof.header->column[col];
+
+        printf("%-12s min=%20.15lf, max=%20.15lf, mean=%20.15lf, stddev=%20.15lf\n",
+               kind_name(c->kind), c->min, c->max, c->mean, c->stddev);
+    }
+
+    printf("checksum=%016lx\n", (unsigned long)prof.header->checksum);
+
+    profile_close(&prof);
+    munmap((void *)data, st.st_size);
+    close(fd);
+    free(chunk_start);
+    free(chunk_rows);
+
+    return 0;
+}
+
+
+const char *kind_name(uint32_t kind)
+{
+    static const char *slope_names[]={"?", "accel-slope", "grade-slope", "speed-slope"};
+    size_t idx;
+
+    for(idx=0; idx < NUM_COLUMN_NAMES; idx++)
+    {
+        if(column_names[idx].kind == kind)
+            return column_names[idx].name;
+    }
+
+    if(((kind & PROFILE_COL_SLOPE) != 0) && ((kind & 0xff) <= PROFILE_COL_SPEED_LIMIT))
+        return slope_names[kind & 0xff];
+
+    return "?";
+}
+
+
+// Comma separated list of column names to PROFILE_COL_* kinds, returns the number of columns or -1
+int parse_columns(const char *list, uint32_t *kinds, uint32_t *units)
+{
+    int ncols=0;
+    size_t len, idx;
+
+    while(*list != '\0')
+    {
+        len = strcspn(list, ",");
+
+        for(idx=0; idx < NUM_COLUMN_NAMES; idx++)
+        {
+            if((strlen(column_names[idx].name) == len) && (strncmp(list, column_names[idx].name, len) == 0))
+                break;
+        }
+
+        if(idx == NUM_COLUMN_NAMES)
+        {
+            printf("Unknown column \"%.*s\", use time, accel, grade or speed\n", (int)len, list);
+            return -1;
+        }
+
+        if(ncols == MAX_CSV_COLUMNS)
+        {
+            printf("At most %d columns can be converted\n", MAX_CSV_COLUMNS);
+            return -1;
+        }
+
+        kinds[ncols] = column_names[idx].kind;
+        units[ncols] = column_names[idx].units;
+        ncols++;
+
+        list += len;
+        if(*list == ',') list++;
+    }
+
+    return ncols;
+}
+
+
+// A row is any line that does not start with a line ending, so blank lines are skipped here and in parse_rows
+uint64_t count_rows(const char *p, const char *end)
+{
+    const char *eol;
+    uint64_t rows=0;
+
+    while(p < end)
+    {
+        if((*p != '\n') && (*p != '\r'))
+            rows++;
+
+        eol = memchr(p, '\n', end - p);
+        p = (eol == NULL) ? end : eol+1;
+    }
+
+    return rows;
+}
+
+
+// Parse the rows from p to end into column[0..ncols-1] starting at row, returns NULL or the line in error
+const char *parse_rows(const char *p, const char *end, int ncols, double **column, uint64_t row)
+{
+    const char *line, *eol;
+    int col;
+
+    while(p < end)
+    {
+        if((*p == '\n') || (*p == '\r'))
+        {
+            eol = memchr(p, '\n', end - p);
+            p = (eol == NULL) ? end : eol+1;
+            continue;
+        }
+
+        line = p;
+
+        for(col=0; col < ncols; col++)
+        {
+            while((p < end) && ((*p == ' ') || (*p == '\t'))) p++;
+
+            if((p = parse_double(p, end, &column[col][row])) == NULL)
+                return line;
+
+            while((p < end) && ((*p == ' ') || (*p == '\t'))) p++;
+
+            if((col < ncols-1) && ((p == end) || (*p++ != ',')))
+                return line;
+        }
+
+        // ignore any extra columns
+        eol = memchr(p, '\n', end - p);
+        p = (eol == NULL) ? end : eol+1;
+        row++;
+    }
+
+    return NULL;
+}
+
+
+// Fast decimal to double
+//
+// Up to 19 significant digits are accumulated into a 64-bit integer, and when that integer is exact in a double
+// (< 2^53) and the power of 10 is exact too (<= 1e22), a single multiply or divide is correctly rounded - this
+// covers the 15 digit values the spreadsheets write.  Anything else falls back to strtod.
+//
+// Returns a pointer just past the number, or NULL if there is no number at p.
+//
+const char *parse_double(const char *p, const char *end, double *value)
+{
+    static const double pow10[]={1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    const char *start = p;
+    uint64_t mantissa=0;
+    int digits=0, significant=0, exponent=0, exp_value=0, exp_negative=0, negative=0, truncated=0;
+
+    if((p < end) && ((*p == '-') || (*p == '+')))
+        negative = (*p++ == '-');
+
+    for(; (p < end) && (*p >= '0') && (*p <= '9'); p++, digits++)
+    {
+        if(significant < 19)
+        {
+            mantissa = mantissa*10 + (*p - '0');
+            if(mantissa != 0) significant++;
+        }
+        else
+        {
+            exponent++;
+            truncated |= (*p != '0');
+        }
+    }
+
+    if((p < end) && (*p == '.'))
+    {
+        for(p++; (p < end) && (*p >= '0') && (*p <= '9'); p++, digits++)
+        {
+            if(significant < 19)
+            {
+                mantissa = mantissa*10 + (*p - '0');
+                if(mantissa != 0) significant++;
+                exponent--;
+            }
+            else
+                truncated |= (*p != '0');
+        }
+    }
+
+    if(digits == 0)
+        return NULL;
+
+    if((p < end) && ((*p == 'e') || (*p == 'E')))
+    {
+        p++;
+
+        if((p < end) && ((*p == '-') || (*p == '+')))
+            exp_negative = (*p++ == '-');
+
+        if((p == end) || (*p < '0') || (*p > '9'))
+            return NULL;
+
+        for(; (p < end) && (*p >= '0') && (*p <= '9'); p++)
+        {
+            if(exp_value < 10000)
+                exp_value = exp_value*10 + (*p - '0');
+        }
+
+        exponent += exp_negative ? -exp_value : exp_value;
+    }
+
+    if(!truncated && (mantissa < (1ULL << 53)) && (exponent >= -22) && (exponent <= 22))
+    {
+        *value = (exponent < 0) ? (double)mantissa / pow10[-exponent] : (double)mantissa * pow10[exponent];
+    }
+    else
+    {
+        char buffer[128];
+        int len = (int)(p - start);
+
+        if(len >= (int)sizeof(buffer))
+            return NULL;
+
+        memcpy(buffer, start, len);
+        buffer[len] = '\0';
+        *value = strtod(buffer, NULL);
+        return p;
+    }
+
+    if(negative)
+        *value = -*value;
+
+    return p;
+}
@@ -0,0 +1,399 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "dopri5.h"
+
+// Adaptive Dormand-Prince 5(4) integrator - see dopri5.h
+
+// Butcher tableau
+#define C2 (1.0/5.0)
+#define C3 (3.0/10.0)
+#define C4 (4.0/5.0)
+#define C5 (8.0/9.0)
+
+#define A21 (1.0/5.0)
+#define A31 (3.0/40.0)
+#define A32 (9.0/40.0)
+#define A41 (44.0/45.0)
+#define A42 (-56.0/15.0)
+#define A43 (32.0/9.0)
+#define A51 (19372.0/6561.0)
+#define A52 (-25360.0/2187.0)
+#define A53 (64448.0/6561.0)
+#define A54 (-212.0/729.0)
+#define A61 (9017.0/3168.0)
+#define A62 (-355.0/33.0)
+#define A63 (46732.0/5247.0)
+#define A64 (49.0/176.0)
+#define A65 (-5103.0/18656.0)
+
+// 5th order weights, which are also the last row since the pair is FSAL (first same as last)
+#define A71 (35.0/384.0)
+#define A73 (500.0/1113.0)
+#define A74 (125.0/192.0)
+#define A75 (-2187.0/6784.0)
+#define A76 (11.0/84.0)
+
+// Difference between the 5th and 4th order weights, giving the local error estimate
+#define E1 (71.0/57600.0)
+#define E3 (-71.0/16695.0)
+#define E4 (71.0/1920.0)
+#define E5 (-17253.0/339200.0)
+#define E6 (22.0/525.0)
+#define E7 (-1.0/40.0)
+
+// Continuous extension
+#define D1 (-12715105075.0/11282082432.0)
+#define D3 (87487479700.0/32700410799.0)
+#define D4 (-10690763975.0/1880347072.0)
+#define D5 (701980252875.0/199316789632.0)
+#define D6 (-1453857185.0/822651844.0)
+#define D7 (69997945.0/29380423.0)
+
+// Step size control
+#define SAFETY (0.9)
+#define FAC_MIN (0.2)
+#define FAC_MAX (10.0)
+
+
+// RMS over the components of v scaled by atol + rtol*max(|y0|, |y1|)
+static double scaled_norm(const dopri_t *s, const double *v, const double *y0, const double *y1)
+{
+    double sum = 0.0, sc;
+    int i;
+
+    for(i=0; i < s->dim; i++)
+    {
+        sc = s->atol + s->rtol * fmax(fabs(y0[i]), fabs(y1[i]));
+        sum += (v[i]/sc) * (v[i]/sc);
+    }
+
+    return sqrt(sum / s->dim);
+}
+
+
+// Starting step from the size of the solution and its derivatives (Hairer's hinit)
+static double initial_step(dopri_t *s)
+{
+    double y1[DOPRI_MAX_DIM], f1[DOPRI_MAX_DIM], diff[DOPRI_MAX_DIM];
+    double d0, d1, d2, h0, h1;
+    int i;
+
+    d0 = scaled_norm(s, s->y, s->y, s->y);
+    d1 = scaled_norm(s, s->k1, s->y, s->y);
+    h0 = ((d0 < 1.0e-5) || (d1 < 1.0e-5)) ? 1.0e-6 : 0.01 * d0 / d1;
+
+    for(i=0; i < s->dim; i++)
+        y1[i] = s->y[i] + h0 * s->k1[i];
+
+    s->rhs(s->t + h0, y1, f1, s->ctx);
+    s->evaluations++;
+
+    for(i=0; i < s->dim; i++)
+        diff[i] = f1[i] - s->k1[i];
+
+    d2 = scaled_norm(s, diff, s->y, s->y) / h0;
+
+    if(fmax(d1, d2) <= 1.0e-15)
+        h1 = fmax(1.0e-6, h0 * 1.0e-3);
+    else
+        h1 = pow(0.01 / fmax(d1, d2), 1.0/5.0);
+
+    return fmin(100.0 * h0, h1);
+}
+
+
+void dopri_init(dopri_t *s, int dim, ode_rhs *rhs, void *ctx, double t0, const double *y0, double atol, double rtol)
+{
+    if((dim < 1) || (dim > DOPRI_MAX_DIM))
+    {
+        printf("dopri_init: dimension %d must be 1 to %d\n", dim, DOPRI_MAX_DIM);
+        exit(-1);
+    }
+
+    memset(s, 0, sizeof(dopri_t));
+
+    s->dim = dim;
+    s->rhs = rhs;
+    s->ctx = ctx;
+    s->atol = atol;
+    s->rtol = rtol;
+    s->t = s->t_old = t0;
+    memcpy(s->y, y0, dim * sizeof(double));
+
+    s->rhs(s->t, s->y, s->k1, s->ctx);
+    s->evaluations = 1;
+
+    s->h = initial_step(s);
+}
+
+
+int dopri_step(dopri_t *s, double t_end)
+{
+    double k2[DOPRI_MAX_DIM], k3[DOPRI_MAX_DIM], k4[DOPRI_MAX_DIM], k5[DOPRI_MAX_DIM], k6[DOPRI_MAX_DIM];
+    double k7[DOPRI_MAX_DIM], ytmp[DOPRI_MAX_DIM], ynew[DOPRI_MAX_DIM], err[DOPRI_MAX_DIM];
+    double h, errnorm, fac;
+    int i, last;
+
+    while(1)
+    {
+        h = s->h;
+
+        if((s->hmax > 0.0) && (h > s->hmax)) h = s->hmax;
+
+        // land exactly on t_end rather than stepping past it
+        last = (s->t + 1.01*h >= t_end);
+        if(last) h = t_end - s->t;
+
+        if(h < 1.0e-14 * fmax(1.0, fabs(s->t)))
+        {
+            printf("dopri_step: step size %le underflow at t=%lf\n", h, s->t);
+            return -1;
+        }
+
+        for(i=0; i < s->dim; i++) ytmp[i] = s->y[i] + h*A21*s->k1[i];
+        s->rhs(s->t + C2*h, ytmp, k2, s->ctx);
+
+        for(i=0; i < s->dim; i++) ytmp[i] = s->y[i] + h*(A31*s->k1[i] + A32*k2[i]);
+        s->rhs(s->t + C3*h, ytmp, k3, s->ctx);
+
+        for(i=0; i < s->dim; i++) ytmp[i] = s->y[i] + h*(A41*s->k1[i] + A42*k2[i] + A43*k3[i]);
+        s->rhs(s->t + C4*h, ytmp, k4, s->ctx);
+
+        for(i=0; i < s->dim; i++) ytmp[i] = s->y[i] + h*(A51*s->k1[i] + A52*k2[i] + A53*k3[i] + A54*k4[i]);
+        s->rhs(s->t + C5*h, ytmp, k5, s->ctx);
+
+        for(i=0; i < s->dim; i++) ytmp[i] = s->y[i] + h*(A61*s->k1[i] + A62*k2[i] + A63*k3[i] + A64*k4[i] + A65*k5[i]);
+        s->rhs(s->t + h, ytmp, k6, s->ctx);
+
+        for(i=0; i < s->dim; i++) ynew[i] = s->y[i] + h*(A71*s->k1[i] + A73*k3[i] + A74*k4[i] + A75*k5[i] + A76*k6[i]);
+        s->rhs(s->t + h, ynew, k7, s->ctx);
+
+        s->evaluations += 6;
+
+        for(i=0; i < s->dim; i++)
+            err[i] = h*(E1*s->k1[i] + E3*k3[i] + E4*k4[i] + E5*k5[i] + E6*k6[i] + E7*k7[i]);
+
+        errnorm = scaled_norm(s, err, s->y, ynew);
+
+        // Next step size from the error of this one, whether or not it is accepted
+        fac = (errnorm > 0.0) ? SAFETY * pow(errnorm, -1.0/5.0) : FAC_MAX;
+        fac = fmin(FAC_MAX, fmax(FAC_MIN, fac));
+
+        if(errnorm <= 1.0)
+            break;
+
+        s->h = h * fmin(1.0, fac);
+        s->rejected++;
+    }
+
+    // Accept - save the continuous extension for dopri_dense before moving on
+    for(i=0; i < s->dim; i++)
+    {
+        double ydiff = ynew[i] - s->y[i];
+        double bspl = h*s->k1[i] - ydiff;
+
+        s->rcont[0][i] = s->y[i];
+        s->rcont[1][i] = ydiff;
+        s->rcont[2][i] = bspl;
+        s->rcont[3][i] = ydiff - h*k7[i] - bspl;
+        s->rcont[4][i] = h*(D1*s->k1[i] + D3*k3[i] + D4*k4[i] + D5*k5[i] + D6*k6[i] + D7*k7[i]);
+
+        s->err_sum[i] += fabs(err[i]);
+        s->y[i] = ynew[i];
+        s->k1[i] = k7[i];
+    }
+
+    s->t_old = s->t;
+    s->h_old = h;
+    s->t = last ? t_end : s->t + h;
+    s->steps++;
+
+    // don't let the shortened last step shrink the next one
+    if(!last || (fac > 1.0))
+        s->h = h * fac;
+
+    return 0;
+}
+
+
+int dopri_integrate(dopri_t *s, double t_end)
+{
+    while(s->t < t_end)
+    {
+        if(dopri_step(s, t_end) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+
+void dopri_dense(const dopri_t *s, double t, double *y)
+{
+    double theta = (s->h_old > 0.0) ? (t - s->t_old) / s->h_old : 0.0;
+    double theta1 = 1.0 - theta;
+    int i;
+
+    for(i=0; i < s->dim; i++)
+        y[i] = s->rcont[0][i] + theta*(s->rcont[1][i] + theta1*(s->rcont[2][i] + theta*(s->rcont[3][i] + theta1*s->rcont[4][i])));
+}
+
+
+void dopri_events_init(const dopri_t *s, dopri_event_t *events, int nevents)
+{
+    int k;
+
+    for(k=0; k < nevents; k++)
+    {
+        events[k].count = 0;
+        events[k].g_last = events[k].g(s->t, s->y, events[k].ctx);
+    }
+}
+
+
+// Does g going from g0 to g1 cross zero in the event's direction
+static int event_crossed(const dopri_event_t *e, double g0, double g1)
+{
+    int rising = (g0 < 0.0) && (g1 >= 0.0), falling = (g0 > 0.0) && (g1 <= 0.0);
+
+    return (e->direction == DOPRI_EVENT_RISING) ? rising : ((e->direction == DOPRI_EVENT_FALLING) ? falling : (rising || falling));
+}
+
+
+// Crossing time of e within the last accepted step, where g goes from g0 at t_old to g1 at t
+//
+// Illinois: regula falsi, but when the same end point is kept twice in a row its g is halved, so the bracket
+// shrinks from both sides and convergence is superlinear instead of stalling on one end.
+//
+static double event_locate(const dopri_t *s, const dopri_event_t *e, double g0, double g1, double *y)
+{
+    double ta = s->t_old, tb = s->t, ga = g0, gb = g1, tc = tb, gc;
+    int side = 0, iter;
+
+    for(iter=0; (iter < 100) && (tb - ta > DOPRI_EVENT_TOL * (1.0 + fabs(tb))); iter++)
+    {
+        tc = (ga*tb - gb*ta) / (ga - gb);
+        dopri_dense(s, tc, y);
+        gc = e->g(tc, y, e->ctx);
+
+        if(gc == 0.0)
+            return tc;
+
+        if((gc < 0.0) == (ga < 0.0))
+        {
+            ta = tc; ga = gc;
+            if(side == -1) gb /= 2.0;
+            side = -1;
+        }
+        else
+        {
+            tb = tc; gb = gc;
+            if(side == 1) ga /= 2.0;
+            side = 1;
+        }
+    }
+
+    // the end of the bracket where g has crossed, so a terminal event never stops short of its condition
+    dopri_dense(s, tb, y);
+    return tb;
+}
+
+
+int dopri_events(dopri_t *s, double t_end, dopri_event_t *events, int nevents)
+{
+    double g_new[nevents], t_event[nevents], y_event[nevents][DOPRI_MAX_DIM];
+    int crossed[nevents];
+    int k, i, stop;
+    double t_stop;
+
+    while(s->t < t_end)
+    {
+        if(dopri_step(s, t_end) < 0)
+            return -1;
+
+        // locate every crossing in this step, and the earliest terminal one
+        stop = -1;
+        t_stop = s->t;
+
+        for(k=0; k < nevents; k++)
+        {
+            g_new[k] = events[k].g(s->t, s->y, events[k].ctx);
+            crossed[k] = event_crossed(&events[k], events[k].g_last, g_new[k]);
+
+            if(crossed[k])
+            {
+                t_event[k] = event_locate(s, &events[k], events[k].g_last, g_new[k], y_event[k]);
+
+                if(events[k].terminal && ((stop < 0) || (t_event[k] < t_stop)))
+                {
+                    stop = k;
+                    t_stop = t_event[k];
+                }
+            }
+        }
+
+        // record them, leaving out any found past the terminal event
+        for(k=0; k < nevents; k++)
+        {
+            if(crossed[k] && ((stop < 0) || (t_event[k] <= t_stop)))
+            {
+                if(events[k].count == 0)
+                {
+                    events[k].t = t_event[k];
+                    for(i=0; i < s->dim; i++)
+                        events[k].y[i] = y_event[k][i];
+                }
+                events[k].count++;
+            }
+
+            events[k].g_last = g_new[k];
+        }
+
+        if(stop >= 0)
+            return stop + 1;
+    }
+
+    return 0;
+}
+
+
+void train_rhs(double t, const double *y, double *dydt, void *ctx)
+{
+    double (*accel)(double) = *(double (**)(double))ctx;
+
+    dydt[0] = accel(t);
+    dydt[1] = y[0];
+}
+
+
+void Dopri_Train(double a, double b, double accel(double), double atol, double rtol, double *vel, double *pos, dopri_t *s)
+{
+    double y0[2] = {0.0, 0.0};
+    double (*accel_ptr)(double) = accel;
+
+    dopri_init(s, 2, train_rhs, &accel_ptr, a, y0, atol, rtol);
+
+    if(dopri_integrate(s, b) < 0)
+        exit(-1);
+
+    *vel = s->y[0];
+    *pos = s->y[1];
+
+    // ctx pointed at this stack frame
+    s->ctx = NULL;
+}
+
+
+double train_position_event(double t, const double *y, void *ctx)
+{
+    return y[1] - *(double *)ctx;
+}
+
+
+double train_velocity_event(double t, const double *y, void *ctx)
+{
+    return y[0] - *(double *)ctx;
+}
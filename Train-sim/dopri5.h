@@ -0,0 +1,114 @@
+#ifndef DOPRI5_H
+#define DOPRI5_H
+
+// Adaptive Dormand-Prince 5(4) integrator with dense output
+//
+// The fixed dt integrators take the same step everywhere, so the cluster runs use dt=5e-5 (36M steps) even for
+// the smooth ex3 profile.  This embedded Runge-Kutta pair estimates the local error of each step from the
+// difference of its 5th and 4th order solutions and picks the next step size to keep that error within
+//
+//     atol + rtol*|y|
+//
+// per component, so smooth stretches are crossed in a few large steps.  Each accepted step also leaves a 4th
+// order interpolant over the step (Hairer's continuous extension), so the solution can be sampled at any time
+// without stepping to it.
+//
+// Reference - Hairer, Norsett & Wanner, Solving Ordinary Differential Equations I, section II.5 and dopri5.f
+//
+#define DOPRI_MAX_DIM (8)
+
+// dydt = f(t, y) for a system of dim equations, with ctx passed through
+typedef void ode_rhs(double t, const double *y, double *dydt, void *ctx);
+
+typedef struct
+{
+    int dim;
+    ode_rhs *rhs;
+    void *ctx;
+    double atol, rtol;
+    double hmax;                        // largest step allowed, 0.0 for no limit
+    double t, h;                        // current time and next step size to try
+    double y[DOPRI_MAX_DIM];
+    double k1[DOPRI_MAX_DIM];           // dydt at (t, y), reused as the first stage of the next step
+
+    // Dense output over the last accepted step [t_old, t]
+    double t_old, h_old;
+    double rcont[5][DOPRI_MAX_DIM];
+
+    // Statistics
+    unsigned long steps, rejected, evaluations;
+    double err_sum[DOPRI_MAX_DIM];      // sum of the local error estimates of all accepted steps
+} dopri_t;
+
+// Start at (t0, y0) with the given tolerances
+void dopri_init(dopri_t *s, int dim, ode_rhs *rhs, void *ctx, double t0, const double *y0, double atol, double rtol);
+
+// Take one accepted step, never past t_end - returns 0, or -1 if the step size underflows
+int dopri_step(dopri_t *s, double t_end);
+
+// Step until t reaches t_end - returns 0, or -1 on failure
+int dopri_integrate(dopri_t *s, double t_end);
+
+// State at time t within the last accepted step, t_old <= t <= t
+void dopri_dense(const dopri_t *s, double t, double *y);
+
+
+// Event location
+//
+// An event is a sign change of g(t, y) along the solution, e.g. position - target for arrival, velocity for
+// coming to rest, or velocity - limit for overspeed.  dopri_events() checks g at the end of every accepted step and
+// when it has changed sign locates the crossing on the step's dense output by the Illinois variant of regula falsi,
+// so an event costs a few interpolant evaluations and no extra right hand side calls, and its time is as accurate
+// as the dense output rather than the step size.
+//
+typedef double ode_event(double t, const double *y, void *ctx);
+
+#define DOPRI_EVENT_EITHER (0)
+#define DOPRI_EVENT_RISING (1)              // g goes from negative to zero or positive
+#define DOPRI_EVENT_FALLING (-1)            // g goes from positive to zero or negative
+
+typedef struct
+{
+    ode_event *g;
+    void *ctx;
+    int direction;                          // DOPRI_EVENT_EITHER, _RISING or _FALLING
+    int terminal;                           // stop the integration at this event
+
+    // Set by dopri_events - the first crossing found, and how many have been found
+    unsigned long count;
+    double t, y[DOPRI_MAX_DIM];
+
+    double g_last;                          // g at the end of the last step checked
+} dopri_event_t;
+
+// Time tolerance for locating events
+#define DOPRI_EVENT_TOL (1.0e-10)
+
+// Set up nevents events at the current state of s, with no crossings found - a g that is zero at the start does
+// not count as a crossing
+void dopri_events_init(const dopri_t *s, dopri_event_t *events, int nevents);
+
+// Step until t_end or the earliest terminal event, locating every event crossed on the way - returns 0 at t_end,
+// k+1 when stopped by terminal event k, or -1 if the step size underflows
+//
+// After a terminal event s is at the end of the step that crossed it, and events[k].t and .y hold the event.  The
+// events may be checked over several calls, as the table drivers do one sample interval at a time.
+//
+int dopri_events(dopri_t *s, double t_end, dopri_event_t *events, int nevents);
+
+
+// The train ODE used by the drivers: y = (velocity, position), dv/dt = accel(t), dx/dt = v, with ctx pointing to
+// the double (*accel)(double) to use
+void train_rhs(double t, const double *y, double *dydt, void *ctx);
+
+// Integrate the train from rest over [a, b] with train_rhs, returning the final velocity and position and
+// leaving the step statistics in s
+void Dopri_Train(double a, double b, double accel(double), double atol, double rtol, double *vel, double *pos, dopri_t *s);
+
+// Events on the train state, with ctx pointing to the double threshold: position - threshold and velocity -
+// threshold, so arrival at a position is a rising train_position_event, coming to rest a falling
+// train_velocity_event at 0 and exceeding a speed limit a rising train_velocity_event at the limit
+double train_position_event(double t, const double *y, void *ctx);
+double train_velocity_event(double t, const double *y, void *ctx);
+
+#endif
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+
+#include "ensemble.h"
+#include "trainode.h"
+
+// Ensemble of trains in structure-of-arrays layout - see ensemble.h
+
+#define ENSEMBLE_ALIGN (64)
+
+
+int ensemble_alloc(ensemble_t *e, int n)
+{
+    // whole blocks, so every array is a multiple of the alignment
+    size_t bytes = sizeof(double) * (size_t)((n + ENSEMBLE_BLOCK - 1) / ENSEMBLE_BLOCK) * ENSEMBLE_BLOCK;
+
+    memset(e, 0, sizeof(ensemble_t));
+    e->n = n;
+
+    e->crr = aligned_alloc(ENSEMBLE_ALIGN, bytes);
+    e->mass = aligned_alloc(ENSEMBLE_ALIGN, bytes);
+    e->scale = aligned_alloc(ENSEMBLE_ALIGN, bytes);
+    e->vel = aligned_alloc(ENSEMBLE_ALIGN, bytes);
+    e->pos = aligned_alloc(ENSEMBLE_ALIGN, bytes);
+
+    if((e->crr == NULL) || (e->mass == NULL) || (e->scale == NULL) || (e->vel == NULL) || (e->pos == NULL))
+    {
+        printf("Could not allocate an ensemble of %d trains\n", n);
+        ensemble_free(e);
+        return -1;
+    }
+
+    memset(e->vel, 0, bytes);
+    memset(e->pos, 0, bytes);
+
+    return 0;
+}
+
+
+void ensemble_free(ensemble_t *e)
+{
+    free(e->crr); free(e->mass); free(e->scale);
+    free(e->vel); free(e->pos);
+    e->crr = e->mass = e->scale = e->vel = e->pos = NULL;
+}
+
+
+// dv/dt of one train at velocity v, with the profile's sin already evaluated - the resistance and brake hold are
+// selects rather than branches, so the loops over trains vectorize
+#pragma omp declare simd uniform(amp_sin) notinbranch
+static inline double train_accel(double v, double amp_sin, double scale, double rolling, double drag_per_mass)
+{
+    double a = scale*amp_sin - rolling - ((v > 0.0) ? drag_per_mass*v*v : 0.0);
+
+    return ((v <= 0.0) && (a < 0.0)) ? 0.0 : a;
+}
+
+
+// RK4 over the trains [first, last) of one block, which is small enough that its parameters and state stay in
+// L1/L2 across all the steps
+static void propagate_block(ensemble_t *e, const ensemble_profile_t *profile, int first, int last,
+                            double t0, double h, unsigned long steps)
+{
+    double rolling[ENSEMBLE_BLOCK], drag_per_mass[ENSEMBLE_BLOCK];
+    double *restrict vel = e->vel + first, *restrict pos = e->pos + first;
+    const double *restrict scale = e->scale + first;
+    double s1, s2, s3, t;
+    unsigned long step;
+    int n = last - first, i;
+
+    #pragma omp simd
+    for(i=0; i < n; i++)
+    {
+        rolling[i] = e->crr[first+i] * TRAIN_GRAVITY;
+        drag_per_mass[i] = profile->drag / e->mass[first+i];
+    }
+
+    for(step=0; step < steps; step++)
+    {
+        // the stages' profile values are shared by every train
+        t = t0 + (double)step * h;
+        s1 = profile->amplitude * sin(t / profile->tscale);
+        s2 = profile->amplitude * sin((t + 0.5*h) / profile->tscale);
+        s3 = profile->amplitude * sin((t + h) / profile->tscale);
+
+        #pragma omp simd
+        for(i=0; i < n; i++)
+        {
+            double v = vel[i], v2, v3, v4, k1, k2, k3, k4;
+
+            k1 = train_accel(v, s1, scale[i], rolling[i], drag_per_mass[i]);
+            v2 = v + 0.5*h*k1;
+            k2 = train_accel(v2, s2, scale[i], rolling[i], drag_per_mass[i]);
+            v3 = v + 0.5*h*k2;
+            k3 = train_accel(v3, s2, scale[i], rolling[i], drag_per_mass[i]);
+            v4 = v + h*k3;
+            k4 = train_accel(v4, s3, scale[i], rolling[i], drag_per_mass[i]);
+
+            // dx/dt = v at the stages, and a stage or step that overshoots zero braking is at rest, as train_ode_rhs
+            // and train_ode_project do, so the train never runs backward
+            v2 = (v2 > 0.0) ? v2 : 0.0;
+            v3 = (v3 > 0.0) ? v3 : 0.0;
+            v4 = (v4 > 0.0) ? v4 : 0.0;
+            pos[i] += h*(v + 2.0*v2 + 2.0*v3 + v4)/6.0;
+
+            v += h*(k1 + 2.0*k2 + 2.0*k3 + k4)/6.0;
+            vel[i] = (v > 0.0) ? v : 0.0;
+        }
+    }
+}
+
+
+void Ensemble_Propagate(ensemble_t *e, const ensemble_profile_t *profile, double t0, double t1, unsigned long steps, int thread_count)
+{
+    int nblocks = (e->n + ENSEMBLE_BLOCK - 1) / ENSEMBLE_BLOCK, block;
+    double h = (t1 - t0) / (double)steps;
+
+    if(steps == 0) return;
+
+    #pragma omp parallel for num_threads(thread_count) schedule(dynamic, 1)
+    for(block=0; block < nblocks; block++)
+    {
+        int first = block * ENSEMBLE_BLOCK;
+        int last = (first + ENSEMBLE_BLOCK < e->n) ? first + ENSEMBLE_BLOCK : e->n;
+
+        propagate_block(e, profile, first, last, t0, h, steps);
+    }
+}
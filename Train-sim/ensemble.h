@@ -0,0 +1,50 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+// Ensemble of trains in structure-of-arrays layout
+//
+// One train per MPI rank gives one Monte Carlo sample per rank per run.  The ensemble instead propagates n trains
+// at once, each with its own parameters, stored as one array per parameter and per state variable, so a loop over
+// trains is unit stride and vectorizes (SIMD across trains).  The trains are split into blocks of ENSEMBLE_BLOCK
+// that stay in cache for the whole run, one block at a time per thread (OpenMP across blocks).
+//
+// Every train follows the same profile shape, scaled per train, against its own resistance:
+//
+//     dv/dt = scale * amplitude * sin(t/tscale) - (Crr*g + drag*v^2/mass)
+//     dx/dt = v
+//
+// so the profile is evaluated once per RK4 stage for a whole block and each train costs only multiply-adds.  As in
+// trainode.h, resistance and brakes stop a train but never run it backward, and a train at rest only starts once
+// the profile overcomes its rolling resistance.
+//
+#define ENSEMBLE_BLOCK (256)
+
+typedef struct
+{
+    int n;
+
+    // Parameters
+    double *crr;                            // coefficient of rolling resistance
+    double *mass;                           // kg
+    double *scale;                          // multiplies the profile acceleration
+
+    // State
+    double *vel, *pos;
+} ensemble_t;
+
+// Shared by all trains
+typedef struct
+{
+    double amplitude;                       // m/s^2 at scale 1
+    double tscale;                          // s, the profile is sin(t/tscale)
+    double drag;                            // aerodynamic drag force per (m/s)^2, N s^2/m^2
+} ensemble_profile_t;
+
+// Allocate n trains, cache line aligned, with the state at rest - returns 0, or -1 with a message printed
+int ensemble_alloc(ensemble_t *e, int n);
+void ensemble_free(ensemble_t *e);
+
+// Advance every train from t0 to t1 with steps RK4 steps
+void Ensemble_Propagate(ensemble_t *e, const ensemble_profile_t *profile, double t0, double t1, unsigned long steps, int thread_count);
+
+#endif
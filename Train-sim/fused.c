@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include "fused.h"
+#include "partition.h"
+
+// Fused velocity and position integration - see fused.h
+
+
+// Fused_Sweep with the acceleration at a given by *a0 if it is not NULL, and returning the acceleration at b, which
+// every rule evaluates last
+static void sweep(int integrator, double a, double b, unsigned long n, double accel(double), const double *a0_given,
+                  double *dv, double *dx, double *a_end)
+{
+    double h, time, v=0.0, x=0.0, v1, a0, am, a1=0.0;
+    unsigned long idx;
+
+    *dv = 0.0;
+    *dx = 0.0;
+
+    if(n == 0) return;
+
+    h = (b - a) / (double)n;
+
+    switch(integrator)
+    {
+        case 1:
+            a0 = (a0_given != NULL) ? *a0_given : accel(a);
+
+            for(idx=0; idx < n; idx++)
+            {
+                time = a + (idx+1)*h;
+                a1 = accel(time);
+                v1 = v + h*(a0 + a1)/2.0;
+                x += h*(v + v1)/2.0;
+                v = v1;
+                a0 = a1;
+            }
+            break;
+
+        case 2:
+        case 3:
+            a0 = (a0_given != NULL) ? *a0_given : accel(a);
+
+            for(idx=0; idx < n; idx++)
+            {
+                time = a + idx*h;
+                am = accel(time + 0.5*h);
+                a1 = accel(time + h);
+                x += h*v + h*h*(a0 + 2.0*am)/6.0;
+                v += h*(a0 + 4.0*am + a1)/6.0;
+                a0 = a1;
+            }
+            break;
+
+        case 0:
+        default:
+            for(idx=1; idx <= n; idx++)
+            {
+                time = a + idx*h;
+                a1 = accel(time);
+                v += h*a1;
+                x += h*v;
+            }
+            break;
+    }
+
+    *dv = v;
+    *dx = x;
+    *a_end = a1;
+}
+
+
+void Fused_Sweep(int integrator, double a, double b, unsigned long n, double accel(double), double *dv, double *dx)
+{
+    double a_end;
+
+    sweep(integrator, a, b, n, accel, NULL, dv, dx, &a_end);
+}
+
+
+void Fused_Integrate(int integrator, double a, double b, unsigned long n, double accel(double), int thread_count,
+                     double *vel, double *pos)
+{
+    fused_state_t s;
+
+    Fused_Start(&s, a, accel);
+    Fused_Extend(&s, integrator, b, n, accel, thread_count);
+
+    *vel = s.vel;
+    *pos = s.pos;
+}
+
+
+void Fused_Start(fused_state_t *s, double t0, double accel(double))
+{
+    s->time = t0;
+    s->vel = 0.0;
+    s->pos = 0.0;
+    s->accel = accel(t0);
+}
+
+
+void Fused_Extend(fused_state_t *s, int integrator, double t_end, unsigned long n, double accel(double), int thread_count)
+{
+    double a = s->time, h, *chunk_dv, *chunk_dx, *chunk_len, *chunk_accel;
+    int chunk, nchunks=1;
+
+    if(n == 0) return;
+
+    h = (t_end - a) / (double)n;
+    chunk_dv = malloc(sizeof(double) * thread_count);
+    chunk_dx = malloc(sizeof(double) * thread_count);
+    chunk_len = malloc(sizeof(double) * thread_count);
+    chunk_accel = malloc(sizeof(double) * thread_count);
+
+    if((chunk_dv == (double *)0) || (chunk_dx == (double *)0) || (chunk_len == (double *)0) || (chunk_accel == (double *)0))
+    {
+        printf("Fused_Extend: could not allocate %d chunks\n", thread_count);
+        exit(-1);
+    }
+
+    #pragma omp parallel num_threads(thread_count)
+    {
+        int my_rank = omp_get_thread_num();
+        int nthreads = omp_get_num_threads();
+        unsigned long first, last;
+
+        // contiguous block of steps for this thread, in thread order for the stitching below
+        partition_static_range(0, n, my_rank, nthreads, &first, &last);
+
+        #pragma omp single nowait
+        nchunks = nthreads;
+
+        // the first chunk starts from the carried acceleration
+        sweep(integrator, a + first*h, a + last*h, last - first, accel, (first == 0) ? &s->accel : NULL,
+              &chunk_dv[my_rank], &chunk_dx[my_rank], &chunk_accel[my_rank]);
+        chunk_len[my_rank] = (last - first)*h;
+    }
+
+    // Stitch the chunks together in time order: each one started at the velocity reached by all before it
+    for(chunk=0; chunk < nchunks; chunk++)
+    {
+        s->pos += chunk_dx[chunk] + s->vel*chunk_len[chunk];
+        s->vel += chunk_dv[chunk];
+
+        // the last chunk with any steps ends at t_end
+        if(chunk_len[chunk] != 0.0)
+            s->accel = chunk_accel[chunk];
+    }
+
+    s->time = t_end;
+
+    free(chunk_dv);
+    free(chunk_dx);
+    free(chunk_len);
+    free(chunk_accel);
+}
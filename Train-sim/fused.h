@@ -0,0 +1,54 @@
+#ifndef FUSED_H
+#define FUSED_H
+
+// Fused velocity and position integration
+//
+// The drivers integrate velocity (from acceleration) and position (from velocity) in two separate parallel
+// reductions that each walk the whole time range and evaluate their own integrand.  The fused kernel instead
+// advances the state (v, x) of v' = a(t), x' = v together in one sweep that only ever evaluates a(t):
+//
+//     Riemann       v += h*a(t+h);                 x += h*v
+//     Trapezoidal   v1 = v0 + h*(a0 + a1)/2;       x += h*(v0 + v1)/2
+//     Simpson, RK4  v1 = v0 + h*(a0 + 4*am + a1)/6; x += h*v0 + h*h*(a0 + 2*am)/6
+//
+// where a0, am and a1 are a(t), a(t+h/2) and a(t+h) - the RK4 stages for this system, which is Simpson's rule for
+// v, so the two share a kernel.  Each step's a1 is carried as the next step's a0, so that is 1 evaluation per
+// step for Riemann and trapezoidal, and 2 for Simpson and RK4.
+//
+// Split across threads, each chunk is swept starting from v=0, giving its velocity change dv and the position
+// change dx it would have from rest.  Since x over a chunk of length L starting at velocity V is dx + V*L, the
+// chunks are stitched together afterwards with the running sum of dv - the chunk boundary correction.
+//
+
+// Sweep [a, b] in n steps from v=0, x=0 on the calling thread, returning the velocity and position changes
+//
+// integrator is the drivers' 0=Riemann, 1=Trap, 2=Simpson, 3=RK4
+//
+void Fused_Sweep(int integrator, double a, double b, unsigned long n, double accel(double), double *dv, double *dx);
+
+// Final velocity and position over [a, b] in n steps starting from rest, with thread_count OpenMP threads
+void Fused_Integrate(int integrator, double a, double b, unsigned long n, double accel(double), int thread_count,
+                     double *vel, double *pos);
+
+
+// Resumable integration
+//
+// A finished run can be extended to a later time from its end state rather than integrated again from the start,
+// as long as the acceleration profile itself does not change.  The state carries the acceleration at its time,
+// which is the first evaluation of the next sweep for trapezoidal, Simpson and RK4, so an extension in pieces
+// evaluates exactly what one sweep over the whole range would.
+//
+typedef struct
+{
+    double time;                        // integrated up to here
+    double vel, pos;
+    double accel;                       // accel(time)
+} fused_state_t;
+
+// At rest at time t0
+void Fused_Start(fused_state_t *s, double t0, double accel(double));
+
+// Continue s from s->time to t_end in n steps, with thread_count OpenMP threads
+void Fused_Extend(fused_state_t *s, int integrator, double t_end, unsigned long n, double accel(double), int thread_count);
+
+#endif
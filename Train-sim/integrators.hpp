@@ -0,0 +1,195 @@
+#ifndef INTEGRATORS_HPP
+#define INTEGRATORS_HPP
+
+#include <cmath>
+#include <type_traits>
+#include <vector>
+#include <omp.h>
+
+#include "partition.h"
+
+// Compile-time specialized integration kernels
+//
+// The Local_* functions in the C drivers take the integrand as a double func(double) pointer, so every step is an
+// indirect call the compiler cannot inline, and the loop around it cannot be vectorized.  Here the integrand is a
+// functor type and the rule is a type, both template parameters, so each integrate<Rule>(f, ...) instantiation
+// is a plain loop with f's body inlined in it.
+//
+// Every rule is written as a weighted sum over a uniform grid of N=intervals<Rule>(n) intervals of width g:
+//
+//     integral = Rule::factor * g * ( w_a*f(a) + sum(i=1..N-1) Rule::weight(i)*f(a+i*g) + w_b*f(b) )
+//
+// with the weight of an interior node a branch-free function of its index, which is what lets the interior loop
+// run as "#pragma omp simd".  RK4 for a pure quadrature has k2 == k3, so it is Simpson's rule on the half-step
+// grid - written that way it takes 2 evaluations per step instead of 4, since neighboring steps share endpoints.
+//
+// Note that these are the textbook composite rules over the whole range, independent of the thread count.
+//
+// The kernels are generic in the number type as well: with the limits, or the integrand's parameters, as dual
+// numbers (see dual.hpp) the same rule returns the integral and its derivatives with respect to them.  The double
+// instantiations are unchanged - only they take the "omp simd" reduction, which needs an arithmetic type.
+//
+
+namespace trainsim
+{
+
+// Integration rules
+
+struct Riemann                      // right endpoint sum, as Local_Riemann
+{
+    static constexpr const char *name = "Riemann";
+    static constexpr unsigned long refine = 1;
+    static constexpr double factor = 1.0, w_a = 0.0, w_b = 1.0;
+    static inline double weight(unsigned long) { return 1.0; }
+};
+
+struct Trapezoidal
+{
+    static constexpr const char *name = "Trapezoidal";
+    static constexpr unsigned long refine = 1;
+    static constexpr double factor = 1.0, w_a = 0.5, w_b = 0.5;
+    static inline double weight(unsigned long) { return 1.0; }
+};
+
+struct Simpson                      // on an even number of intervals, see intervals()
+{
+    static constexpr const char *name = "Simpson";
+    static constexpr unsigned long refine = 1;
+    static constexpr double factor = 1.0/3.0, w_a = 1.0, w_b = 1.0;
+    static inline double weight(unsigned long i) { return 2.0 + 2.0*(double)(i & 1); }
+};
+
+struct RK4                          // k1 + 2*k2 + 2*k3 + k4 with k2 == k3, Simpson on the half-step grid
+{
+    static constexpr const char *name = "Runge-Kutta-4";
+    static constexpr unsigned long refine = 2;
+    static constexpr double factor = 1.0/3.0, w_a = 1.0, w_b = 1.0;
+    static inline double weight(unsigned long i) { return 2.0 + 2.0*(double)(i & 1); }
+};
+
+
+// Integrands - the analytic ex3 oracles from simtrainideal.c with their scale factors as members, of type T
+
+template<class T = double>
+struct Ex3Accel
+{
+    T tscale, ascale;
+
+    template<class X>
+    inline auto operator()(X time) const { using std::sin; return sin(time/tscale)*ascale; }
+};
+
+template<class T = double>
+struct Ex3Vel
+{
+    T tscale, vscale;
+
+    template<class X>
+    inline auto operator()(X time) const { using std::cos; return (-cos(time/tscale)+1.0)*vscale; }
+};
+
+
+// Number of grid intervals N for n steps, as rule_intervals in rules.h - Simpson's rule needs an even number, so
+// an odd n takes one more
+template<class Rule>
+constexpr unsigned long intervals(unsigned long n)
+{
+    return std::is_same<Rule, Simpson>::value ? n + (n & 1) : n * Rule::refine;
+}
+
+
+// Weighted sum of the interior nodes first..last-1 of the grid a + i*g
+template<class Rule, class F, class T>
+inline auto interior_sum(const F &f, T a, T g, unsigned long first, unsigned long last)
+{
+    using R = decltype(f(a));
+    R sum = R(0.0);
+
+    if constexpr (std::is_arithmetic<R>::value)
+    {
+        #pragma omp simd reduction(+:sum)
+        for(unsigned long i = first; i < last; i++)
+            sum += Rule::weight(i) * f(a + (double)i*g);
+    }
+    else
+    {
+        for(unsigned long i = first; i < last; i++)
+            sum += Rule::weight(i) * f(a + (double)i*g);
+    }
+
+    return sum;
+}
+
+
+// Integral of f over [a, b] in n steps on the calling thread
+template<class Rule, class F, class T>
+auto integrate(const F &f, T a, T b, unsigned long n)
+{
+    using R = decltype(f(a));
+
+    if(n == 0) return R(0.0);
+
+    unsigned long N = intervals<Rule>(n);
+    T g = (b - a) / (double)N;
+    R sum = Rule::w_a*f(a) + Rule::w_b*f(b) + interior_sum<Rule>(f, a, g, 1, N);
+
+    return R(Rule::factor * g * sum);
+}
+
+
+// Integral of f over [a, b] in n steps with thread_count OpenMP threads, each taking a static block of the
+// interior nodes (see partition.h) - the threads' sums are added in thread order for types without an OpenMP
+// reduction
+template<class Rule, class F, class T>
+auto integrate_omp(const F &f, T a, T b, unsigned long n, int thread_count)
+{
+    using R = decltype(f(a));
+
+    if(n == 0) return R(0.0);
+
+    unsigned long N = intervals<Rule>(n);
+    T g = (b - a) / (double)N;
+    R sum = Rule::w_a*f(a) + Rule::w_b*f(b);
+
+    if constexpr (std::is_arithmetic<R>::value)
+    {
+        #pragma omp parallel num_threads(thread_count) reduction(+:sum)
+        {
+            unsigned long first, last;
+
+            partition_static_range(1, N, omp_get_thread_num(), omp_get_num_threads(), &first, &last);
+
+            sum += interior_sum<Rule>(f, a, g, first, last);
+        }
+    }
+    else
+    {
+        std::vector<R> partial(thread_count, R(0.0));
+
+        #pragma omp parallel num_threads(thread_count)
+        {
+            unsigned long first, last;
+
+            partition_static_range(1, N, omp_get_thread_num(), omp_get_num_threads(), &first, &last);
+
+            partial[omp_get_thread_num()] = interior_sum<Rule>(f, a, g, first, last);
+        }
+
+        for(int t = 0; t < thread_count; t++)
+            sum += partial[t];
+    }
+
+    return R(Rule::factor * g * sum);
+}
+
+
+// Number of integrand evaluations integrate<Rule> makes for n steps
+template<class Rule>
+constexpr unsigned long evaluations(unsigned long n)
+{
+    return intervals<Rule>(n) + 1;
+}
+
+} // namespace trainsim
+
+#endif
@@ -0,0 +1,453 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "interp.h"
+
+// Interpolation tables with precomputed segment coefficients - see interp.h
+
+#define ROOT_BISECTIONS (60)
+
+// Points searched together by interp_batch
+#define INTERP_BLOCK (256)
+
+const char *interp_names[3] = {"linear", "pchip", "spline"};
+
+
+// Cubic Hermite segment from y0 to y1 with slopes m0 and m1, all per sample period
+static void hermite_segment(double *c, double y0, double y1, double m0, double m1)
+{
+    double delta = y1 - y0;
+
+    c[0] = y0;
+    c[1] = m0;
+    c[2] = 3.0*delta - 2.0*m0 - m1;
+    c[3] = m0 + m1 - 2.0*delta;
+}
+
+
+// Fritsch-Carlson slopes per second - zero at a local extremum of the samples, the weighted harmonic mean of the
+// neighbouring secants d0 and d1 otherwise, and the one-sided three point formula at the ends, limited so it cannot
+// overshoot.  h0 and h1 are the widths of the segments of d0 and d1, the first one the end one for pchip_end_slope.
+static double pchip_end_slope(double d0, double d1, double h0, double h1)
+{
+    double m = ((2.0*h0 + h1)*d0 - h0*d1) / (h0 + h1);
+
+    if(m*d0 <= 0.0)
+        return 0.0;
+    if((d0*d1 < 0.0) && (fabs(m) > fabs(3.0*d0)))
+        return 3.0*d0;
+    return m;
+}
+
+static double pchip_slope(double d0, double d1, double h0, double h1)
+{
+    double w0 = 2.0*h1 + h0, w1 = h1 + 2.0*h0;
+
+    return (d0*d1 > 0.0) ? (w0 + w1) / (w0/d0 + w1/d1) : 0.0;
+}
+
+// Width of segment i in seconds while the table is built
+static double segment_width(const interp_table_t *t, int i)
+{
+    return interp_width(t, i);
+}
+
+static void pchip_coefficients(interp_table_t *t, const double *y)
+{
+    int i, n = t->count - 1;
+    double m0, m1, h0, h1, d0, d1;
+
+    if(n == 1)
+    {
+        hermite_segment(t->coef, y[0], y[1], y[1] - y[0], y[1] - y[0]);
+        return;
+    }
+
+    h0 = segment_width(t, 0);
+    h1 = segment_width(t, 1);
+    m0 = pchip_end_slope((y[1] - y[0]) / h0, (y[2] - y[1]) / h1, h0, h1);
+
+    for(i=0; i < n; i++)
+    {
+        h0 = segment_width(t, i);
+
+        if(i == n - 1)
+        {
+            h1 = segment_width(t, n-2);
+            m1 = pchip_end_slope((y[n] - y[n-1]) / h0, (y[n-1] - y[n-2]) / h1, h0, h1);
+        }
+        else
+        {
+            h1 = segment_width(t, i+1);
+            d0 = (y[i+1] - y[i]) / h0;
+            d1 = (y[i+2] - y[i+1]) / h1;
+            m1 = pchip_slope(d0, d1, h0, h1);
+        }
+
+        hermite_segment(&t->coef[4*i], y[i], y[i+1], m0*h0, m1*h0);
+        m0 = m1;
+    }
+}
+
+
+// Natural cubic spline - the second derivatives M solve
+//
+//     h[i-1]*M[i-1] + 2*(h[i-1] + h[i])*M[i] + h[i]*M[i+1] = 6*(d[i] - d[i-1])
+//
+// with h the segment widths, d the secants, and M zero at both ends, by the Thomas algorithm
+static int spline_coefficients(interp_table_t *t, const double *y)
+{
+    int i, n = t->count - 1;
+    double *M = calloc(n+1, sizeof(double)), *diag = malloc(sizeof(double) * (n+1)), w, h0, h1;
+
+    if((M == NULL) || (diag == NULL))
+    {
+        printf("Could not allocate spline workspace for %d samples\n", n+1);
+        free(M); free(diag);
+        return -1;
+    }
+
+    // forward elimination, with the right hand side held in M
+    for(i=1; i < n; i++)
+    {
+        h0 = segment_width(t, i-1);
+        h1 = segment_width(t, i);
+        M[i] = 6.0*((y[i+1] - y[i]) / h1 - (y[i] - y[i-1]) / h0);
+        diag[i] = 2.0*(h0 + h1);
+
+        if(i > 1)
+        {
+            w = h0 / diag[i-1];
+            diag[i] -= w * h0;
+            M[i] -= w * M[i-1];
+        }
+    }
+
+    // back substitution, M[n] staying zero
+    for(i=n-1; i >= 1; i--)
+        M[i] = (M[i] - segment_width(t, i) * M[i+1]) / diag[i];
+
+    // in fractions of the segment
+    for(i=0; i < n; i++)
+    {
+        h0 = segment_width(t, i);
+        t->coef[4*i] = y[i];
+        t->coef[4*i+1] = (y[i+1] - y[i]) - h0*h0*(2.0*M[i] + M[i+1]) / 6.0;
+        t->coef[4*i+2] = h0*h0*M[i] / 2.0;
+        t->coef[4*i+3] = h0*h0*(M[i+1] - M[i]) / 6.0;
+    }
+
+    free(M);
+    free(diag);
+    return 0;
+}
+
+
+// Fill tree[k] and its subtrees with the next keys in order, +inf once they run out
+static void eytzinger_fill(interp_table_t *t, int k, int size, int *next)
+{
+    if(k >= size) return;
+
+    eytzinger_fill(t, 2*k, size, next);
+    t->tree[k] = (*next < t->count) ? t->knot[*next] : INFINITY;
+    (*next)++;
+    eytzinger_fill(t, 2*k+1, size, next);
+}
+
+static int knots_build(interp_table_t *t)
+{
+    int i, next = 0;
+
+    for(i=0; i+1 < t->count; i++)
+        if(!(t->knot[i+1] > t->knot[i]))
+        {
+            printf("Sample times must increase, but sample %d is at %lf and sample %d at %lf\n",
+                   i, t->knot[i], i+1, t->knot[i+1]);
+            return -1;
+        }
+
+    for(t->depth=1; (1 << t->depth) - 1 < t->count; t->depth++);
+
+    t->inv_width = malloc(sizeof(double) * t->count);
+    t->tree = aligned_alloc(64, ((sizeof(double) * (1 << t->depth) + 63) / 64) * 64);
+
+    if((t->inv_width == NULL) || (t->tree == NULL))
+    {
+        printf("Could not allocate the sample time search tables for %d samples\n", t->count);
+        return -1;
+    }
+
+    for(i=0; i+1 < t->count; i++)
+        t->inv_width[i] = 1.0 / (t->knot[i+1] - t->knot[i]);
+    t->inv_width[t->count-1] = 0.0;
+
+    t->tree[0] = -INFINITY;
+    eytzinger_fill(t, 1, 1 << t->depth, &next);
+
+    return 0;
+}
+
+
+int interp_build(interp_table_t *t, const double *samples, int count, double period, const double *knot, int scheme)
+{
+    t->count = count;
+    t->scheme = scheme;
+    t->knot = knot;
+    t->inv_width = NULL;
+    t->tree = NULL;
+    t->depth = 0;
+
+    // with sample times, the mean period
+    if((knot != NULL) && (count > 1))
+        period = (knot[count-1] - knot[0]) / (double)(count - 1);
+
+    t->period = period;
+    t->inv_period = 1.0 / period;
+
+    t->coef = aligned_alloc(64, ((sizeof(double) * 4 * count + 63) / 64) * 64);
+
+    if(t->coef == NULL)
+    {
+        printf("Could not allocate an interpolation table of %d samples\n", count);
+        return -1;
+    }
+
+    memset(t->coef, 0, sizeof(double) * 4 * count);
+
+    if((knot != NULL) && (knots_build(t) < 0))
+    {
+        interp_free(t);
+        return -1;
+    }
+
+    if(count < 2)
+        scheme = INTERP_LINEAR;
+
+    if(scheme == INTERP_PCHIP)
+        pchip_coefficients(t, samples);
+    else if(scheme == INTERP_SPLINE)
+    {
+        if(spline_coefficients(t, samples) < 0)
+        {
+            interp_free(t);
+            return -1;
+        }
+    }
+    else
+    {
+        interp_update(t, samples, 0, count);
+        return 0;
+    }
+
+    // the last sample stays flat
+    t->coef[4*(count-1)] = samples[count-1];
+    return 0;
+}
+
+
+void interp_update(interp_table_t *t, const double *samples, int first, int last)
+{
+    int i, end = (last < t->count - 1) ? last : t->count - 1;
+
+    for(i=first; i < end; i++)
+    {
+        t->coef[4*i] = samples[i];
+        t->coef[4*i+1] = samples[i+1] - samples[i];
+    }
+
+    // the last sample stays flat
+    if(last == t->count)
+    {
+        t->coef[4*(last-1)] = samples[last-1];
+        t->coef[4*(last-1)+1] = 0.0;
+    }
+}
+
+
+void interp_update_hermite(interp_table_t *t, const double *samples, const double *slopes, int first, int last)
+{
+    int i, end = (last < t->count - 1) ? last : t->count - 1;
+
+    for(i=first; i < end; i++)
+        hermite_segment(&t->coef[4*i], samples[i], samples[i+1], slopes[i] * interp_width(t, i),
+                        slopes[i+1] * interp_width(t, i));
+
+    if(last == t->count)
+    {
+        t->coef[4*(last-1)] = samples[last-1];
+        t->coef[4*(last-1)+1] = t->coef[4*(last-1)+2] = t->coef[4*(last-1)+3] = 0.0;
+    }
+}
+
+
+void interp_free(interp_table_t *t)
+{
+    free(t->coef);
+    free(t->inv_width);
+    free(t->tree);
+    t->coef = NULL;
+    t->inv_width = NULL;
+    t->tree = NULL;
+}
+
+
+int interp_parse(const char *name, int *scheme)
+{
+    *scheme = INTERP_LINEAR;
+
+    if((name == NULL) || (strcmp(name, "linear") == 0))
+        return 0;
+    else if(strcmp(name, "pchip") == 0)
+        *scheme = INTERP_PCHIP;
+    else if(strcmp(name, "spline") == 0)
+        *scheme = INTERP_SPLINE;
+    else
+    {
+        printf("Unknown interpolation %s, use linear, pchip or spline\n", name);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+// A grid is a sweep forward in time, so with sample times each segment is found from the one before
+//
+// The loops work on a copy of the table header, which out cannot alias, so its fields stay in registers
+void interp_grid(const interp_table_t *table, double t0, double h, unsigned long n, double bias, double *out)
+{
+    interp_table_t copy = *table, *t = &copy;
+    unsigned long k;
+    int hint;
+
+    if(t->knot != NULL)
+    {
+        hint = interp_locate_knots(t, t0);
+
+        for(k=0; k < n; k++)
+        {
+            double time = t0 + (double)k*h;
+
+            out[k] = interp_signed_bias(interp_at_segment(t, interp_locate_from(t, time, &hint), time), bias);
+        }
+        return;
+    }
+
+    #pragma omp simd
+    for(k=0; k < n; k++)
+        out[k] = interp_signed_bias(interp_at_uniform(t, t0 + (double)k*h), bias);
+}
+
+
+void interp_batch(const interp_table_t *table, const double *times, unsigned long n, double bias, double *out)
+{
+    interp_table_t copy = *table, *t = &copy;
+    unsigned long k;
+
+    if(t->knot != NULL)
+    {
+        const double *knot = t->knot, *inv_width = t->inv_width, *coef = t->coef, *tree = t->tree;
+        int node[INTERP_BLOCK], level, last = t->count - 1;
+        unsigned long base, count;
+
+        // the search a level at a time across a block of points, so each level is one vectorized loop of gathers
+        for(base=0; base < n; base += count)
+        {
+            count = (n - base < INTERP_BLOCK) ? n - base : INTERP_BLOCK;
+
+            #pragma omp simd
+            for(k=0; k < count; k++)
+                node[k] = 1;
+
+            for(level=0; level < t->depth; level++)
+            {
+                #pragma omp simd
+                for(k=0; k < count; k++)
+                    node[k] = 2*node[k] + (tree[node[k]] <= times[base+k]);
+            }
+
+            #pragma omp simd
+            for(k=0; k < count; k++)
+            {
+                int i = node[k] - (1 << t->depth) - 1;
+                double frac;
+
+                i = (i > 0) ? i : 0;
+                i = (i < last) ? i : last;
+                frac = (times[base+k] - knot[i]) * inv_width[i];
+                frac = (frac > 0.0) ? frac : 0.0;
+                out[base+k] = interp_signed_bias(INTERP_HORNER(coef, i, frac), bias);
+            }
+        }
+        return;
+    }
+
+    #pragma omp simd
+    for(k=0; k < n; k++)
+        out[k] = interp_signed_bias(interp_at_uniform(t, times[k]), bias);
+}
+
+
+// The segment is monotone between the zeros of its derivative c1 + 2*c2*u + 3*c3*u^2, so each of those pieces
+// holds at most one zero, found by bisection where the ends differ in sign
+int interp_segment_roots(const interp_table_t *t, int i, double roots[3])
+{
+    const double *c = &t->coef[4*i];
+    double A = 3.0*c[3], B = 2.0*c[2], C = c[1], disc, q, r[2], edge[4], lo, hi, mid, vlo, vmid;
+    int nedge = 0, nroots = 0, k, iter;
+
+    edge[nedge++] = 0.0;
+
+    if(A == 0.0)
+    {
+        if((B != 0.0) && (-C/B > 0.0) && (-C/B < 1.0))
+            edge[nedge++] = -C/B;
+    }
+    else if((disc = B*B - 4.0*A*C) > 0.0)
+    {
+        // the stable form of the quadratic formula
+        q = -0.5 * (B + copysign(sqrt(disc), B));
+        r[0] = q / A;
+        r[1] = C / q;
+
+        if(r[0] > r[1]) { mid = r[0]; r[0] = r[1]; r[1] = mid; }
+
+        for(k=0; k < 2; k++)
+            if((r[k] > 0.0) && (r[k] < 1.0))
+                edge[nedge++] = r[k];
+    }
+
+    edge[nedge++] = 1.0;
+
+    for(k=0; k < nedge-1; k++)
+    {
+        lo = edge[k];
+        hi = edge[k+1];
+        vlo = interp_segment_value(t, i, lo);
+
+        // a zero exactly on an interior edge
+        if((k > 0) && (vlo == 0.0))
+        {
+            roots[nroots++] = lo;
+            continue;
+        }
+
+        if(vlo * interp_segment_value(t, i, hi) >= 0.0)
+            continue;
+
+        for(iter=0; iter < ROOT_BISECTIONS; iter++)
+        {
+            mid = 0.5 * (lo + hi);
+            vmid = interp_segment_value(t, i, mid);
+
+            if(vmid * vlo > 0.0) { lo = mid; vlo = vmid; }
+            else hi = mid;
+        }
+
+        roots[nroots++] = 0.5 * (lo + hi);
+    }
+
+    return nroots;
+}
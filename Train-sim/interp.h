@@ -0,0 +1,211 @@
+#ifndef INTERP_H
+#define INTERP_H
+
+// Interpolation of a sampled table from precomputed segment coefficients
+//
+// faccel and fvel looked up two table entries per evaluation, each behind a bounds check, and took their difference
+// every time.  An interp_table_t stores each segment - from sample i to sample i+1 - as a cubic in the fraction
+// frac of the segment since sample i, its four coefficients interleaved, so an evaluation is one clamp, one
+// 32-byte load and three multiply-adds:
+//
+//     x = time/period        i = (int)x clamped to [0, count-1]        frac = x - i, at least 0
+//     value = c[4i] + frac*(c[4i+1] + frac*(c[4i+2] + frac*c[4i+3]))
+//
+// The schemes differ only in the coefficients, computed once when the table is built:
+//
+//     INTERP_LINEAR   straight lines between samples, c = (y[i], y[i+1] - y[i], 0, 0) as before
+//     INTERP_PCHIP    monotone cubic Hermite (Fritsch-Carlson) - continuous slope, and never overshoots the samples,
+//                     so a profile that holds still or changes sign between samples still does
+//     INTERP_SPLINE   natural cubic spline - continuous slope and curvature, the most accurate for smooth
+//                     profiles, but may overshoot next to a step
+//
+// The last sample holds its value flat, so time past the table - the RK4 stage one past the end - gets the last
+// value, and time before it the first.  The clamps are selects, so there are no branches: interp_at_uniform
+// inlines into the drivers' faccel and fvel, and interp_grid/interp_batch evaluate whole blocks of points in one
+// loop that vectorizes (with gathers of the coefficients on AVX2 and AVX-512).  The table is 64-byte aligned, so a
+// segment never straddles a cache line.
+//
+// Samples need not be evenly spaced: given the time of each sample (knots, strictly increasing), segment i runs
+// from knot[i] to knot[i+1] with frac = (time - knot[i]) / (knot[i+1] - knot[i]), so logger data at irregular or
+// mixed rates is used as recorded rather than resampled to the finest rate.  The segment of a time is then found
+//
+//     interp_locate       by a branch-free search of the knots in Eytzinger order - the binary search tree laid
+//                         out level by level, so the first levels share cache lines and every step is one select.
+//                         A fixed number of steps, padded with +inf keys, so interp_batch's loop still vectorizes.
+//     interp_locate_from  from the segment of the previous call, for sweeps forward in time - O(1) amortized,
+//                         falling back to interp_locate on a jump
+//
+// and evaluated with interp_at_segment - the drivers' faccel_knots and fvel_knots do both, with a hint per thread.
+// interp_at dispatches on the table for callers that handle both kinds.
+//
+// A table filled as the run goes, like the velocity table, is refreshed a range of samples at a time with
+// interp_update, or interp_update_hermite where the derivative at the samples is known.  The segment integrals
+// below are exact for every scheme, so the exact propagator needs no dt.
+//
+// References - Fritsch & Carlson, Monotone piecewise cubic interpolation, SIAM J. Numer. Anal. 17(2), 1980
+//              Khuong & Morin, Array layouts for comparison-based searching, ACM J. Exp. Algorithmics 22, 2017
+//
+#define INTERP_LINEAR (0)
+#define INTERP_PCHIP (1)
+#define INTERP_SPLINE (2)
+
+typedef struct
+{
+    double *coef;                           // four coefficients per sample, of the segment that starts there
+    int count;                              // samples
+    int scheme;
+    double period, inv_period;              // seconds between samples, and its reciprocal - the mean with knots
+
+    // non-uniform samples only, NULL otherwise
+    const double *knot;                     // time of each sample, the caller's array
+    double *inv_width;                      // 1/(knot[i+1] - knot[i]), 0 for the last sample
+    double *tree;                           // knots in Eytzinger order from tree[1], padded with +inf
+    int depth;                              // levels of tree, which holds 2^depth - 1 keys
+} interp_table_t;
+
+// Table of count samples with scheme, period seconds apart, or at times knot[] if knot is not NULL - returns 0, or
+// -1 with a message printed
+int interp_build(interp_table_t *t, const double *samples, int count, double period, const double *knot, int scheme);
+
+// Refresh entries first..last-1 of a linear table from samples, after they or the sample after last-1 have changed
+void interp_update(interp_table_t *t, const double *samples, int first, int last);
+
+// The same as cubic Hermite segments, with the derivative of each sample per second in slopes - for a table whose
+// derivative is known, like velocity from acceleration
+void interp_update_hermite(interp_table_t *t, const double *samples, const double *slopes, int first, int last);
+
+void interp_free(interp_table_t *t);
+
+// Scheme named linear, pchip or spline, linear for NULL - returns 0, or -1 with a message printed
+int interp_parse(const char *name, int *scheme);
+
+extern const char *interp_names[3];
+
+// Segment i of coef at frac - indexed from coef rather than through a pointer to the segment, which the vectorizer
+// cannot gather from
+#define INTERP_HORNER(coef, i, frac) \
+    ((coef)[4*(i)] + (frac)*((coef)[4*(i)+1] + (frac)*((coef)[4*(i)+2] + (frac)*(coef)[4*(i)+3])))
+
+// Time of sample i, and the length of segment i in seconds
+static inline double interp_time(const interp_table_t *t, int i)
+{
+    return (t->knot != NULL) ? t->knot[i] : (double)i * t->period;
+}
+
+static inline double interp_width(const interp_table_t *t, int i)
+{
+    return (t->knot != NULL) ? t->knot[i+1] - t->knot[i] : t->period;
+}
+
+// Segment of time for non-uniform samples - the number of knots at or before time, less one, clamped to
+// [0, count-1].  Each step goes right where the key is at or before time, so after depth steps the position k
+// below the leaves counts the keys passed, with no branch and no index table.
+static inline int interp_locate_knots(const interp_table_t *t, double time)
+{
+    int k = 1, level, i, last = t->count - 1;
+
+    for(level=0; level < t->depth; level++)
+        k = 2*k + (t->tree[k] <= time);
+
+    i = k - (1 << t->depth) - 1;
+    i = (i > 0) ? i : 0;
+    return (i < last) ? i : last;
+}
+
+// Value at time for evenly spaced samples - the index is clamped as an integer and the fraction as a double, since
+// clamping time itself stops the loops over it vectorizing
+static inline double interp_at_uniform(const interp_table_t *t, double time)
+{
+    double x = time * t->inv_period, frac;
+    int i = (int)x, last = t->count - 1;
+
+    i = (i > 0) ? i : 0;
+    i = (i < last) ? i : last;
+    frac = x - (double)i;
+    frac = (frac > 0.0) ? frac : 0.0;
+
+    return INTERP_HORNER(t->coef, i, frac);
+}
+
+// Value at time within segment i
+static inline double interp_at_segment(const interp_table_t *t, int i, double time)
+{
+    double frac = (t->knot != NULL) ? (time - t->knot[i]) * t->inv_width[i] : time * t->inv_period - (double)i;
+
+    frac = (frac > 0.0) ? frac : 0.0;
+    return INTERP_HORNER(t->coef, i, frac);
+}
+
+static inline int interp_locate(const interp_table_t *t, double time)
+{
+    int i, last = t->count - 1;
+
+    if(t->knot != NULL)
+        return interp_locate_knots(t, time);
+
+    i = (int)(time * t->inv_period);
+    i = (i > 0) ? i : 0;
+    return (i < last) ? i : last;
+}
+
+// interp_locate starting from *hint, the segment of the previous call, which is updated - checks the same and the
+// next segment before searching
+static inline int interp_locate_from(const interp_table_t *t, double time, int *hint)
+{
+    int i = *hint, last = t->count - 1;
+
+    if(t->knot == NULL)
+        return interp_locate(t, time);
+
+    if((i < last) && (time >= t->knot[i+1]))
+        i++;
+
+    if(((i > 0) && (time < t->knot[i])) || ((i < last) && (time >= t->knot[i+1])))
+        i = interp_locate_knots(t, time);
+
+    *hint = i;
+    return i;
+}
+
+// Interpolated value at time
+static inline double interp_at(const interp_table_t *t, double time)
+{
+    return (t->knot != NULL) ? interp_at_segment(t, interp_locate_knots(t, time), time) : interp_at_uniform(t, time);
+}
+
+// value + bias in the direction of the sign of value - the rolling deceleration shift of faccel, without a branch
+static inline double interp_signed_bias(double value, double bias)
+{
+    return value + bias * (double)((value > 0.0) - (value < 0.0));
+}
+
+// out[k] = interp_signed_bias(interp_at(t, t0 + k*h), bias) for k=0..n-1 - bias 0 for the plain values
+void interp_grid(const interp_table_t *t, double t0, double h, unsigned long n, double bias, double *out);
+
+// The same at arbitrary times[k]
+void interp_batch(const interp_table_t *t, const double *times, unsigned long n, double bias, double *out);
+
+// Segment i at frac u, and its first and second integrals from frac 0 to u - in fractions of the segment, so
+// multiply the integrals by interp_width and its square for seconds
+static inline double interp_segment_value(const interp_table_t *t, int i, double u)
+{
+    const double *c = &t->coef[4*i];
+    return c[0] + u*(c[1] + u*(c[2] + u*c[3]));
+}
+
+static inline double interp_segment_integral(const interp_table_t *t, int i, double u)
+{
+    const double *c = &t->coef[4*i];
+    return u*(c[0] + u*(c[1]/2.0 + u*(c[2]/3.0 + u*c[3]/4.0)));
+}
+
+static inline double interp_segment_integral2(const interp_table_t *t, int i, double u)
+{
+    const double *c = &t->coef[4*i];
+    return u*u*(c[0]/2.0 + u*(c[1]/6.0 + u*(c[2]/12.0 + u*c[3]/20.0)));
+}
+
+// Zeros of segment i strictly inside (0, 1), ascending - returns how many, at most 3
+int interp_segment_roots(const interp_table_t *t, int i, double roots[3]);
+
+#endif
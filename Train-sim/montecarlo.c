@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "montecarlo.h"
+
+// Monte Carlo building blocks - see montecarlo.h
+
+
+void welford_init(welford_t *w)
+{
+    w->n = 0.0;
+    w->mean = 0.0;
+    w->m2 = 0.0;
+    w->min = INFINITY;
+    w->max = -INFINITY;
+}
+
+
+void welford_add(welford_t *w, double x)
+{
+    double delta = x - w->mean;
+
+    w->n += 1.0;
+    w->mean += delta / w->n;
+    w->m2 += delta * (x - w->mean);
+
+    if(x < w->min) w->min = x;
+    if(x > w->max) w->max = x;
+}
+
+
+void welford_merge(welford_t *w, const welford_t *other)
+{
+    double n = w->n + other->n, delta = other->mean - w->mean;
+
+    if(other->n == 0.0) return;
+
+    w->mean += delta * other->n / n;
+    w->m2 += other->m2 + delta*delta * w->n * other->n / n;
+    w->n = n;
+
+    if(other->min < w->min) w->min = other->min;
+    if(other->max > w->max) w->max = other->max;
+}
+
+
+double welford_sd(const welford_t *w)
+{
+    return (w->n > 1.0) ? sqrt(w->m2 / (w->n - 1.0)) : 0.0;
+}
+
+
+// log(gamma), the width of a bucket in log space
+static double qsketch_log_gamma(void)
+{
+    return log((1.0 + QSKETCH_ALPHA) / (1.0 - QSKETCH_ALPHA));
+}
+
+
+void qsketch_init(qsketch_t *s)
+{
+    memset(s, 0, sizeof(qsketch_t));
+}
+
+
+void qsketch_add(qsketch_t *s, double x)
+{
+    double lg = qsketch_log_gamma();
+    long k;
+
+    if(x <= QSKETCH_MIN)
+        k = 0;
+    else
+    {
+        k = (long)ceil((log(x) - log(QSKETCH_MIN)) / lg);
+        if(k >= QSKETCH_BUCKETS) k = QSKETCH_BUCKETS-1;
+    }
+
+    s->count[k] += 1.0;
+    s->total += 1.0;
+}
+
+
+void qsketch_merge(qsketch_t *s, const qsketch_t *other)
+{
+    int k;
+
+    for(k=0; k < QSKETCH_BUCKETS; k++)
+        s->count[k] += other->count[k];
+
+    s->total += other->total;
+}
+
+
+double qsketch_quantile(const qsketch_t *s, double q)
+{
+    double rank, seen = 0.0, lg = qsketch_log_gamma();
+    int k;
+
+    if(s->total == 0.0) return 0.0;
+
+    rank = q * (s->total - 1.0);
+
+    for(k=0; k < QSKETCH_BUCKETS-1; k++)
+    {
+        seen += s->count[k];
+        if(seen > rank) break;
+    }
+
+    if(k == 0) return QSKETCH_MIN;
+
+    // the midpoint of (gamma^(k-1), gamma^k] in relative terms, 2*gamma^k/(gamma+1)
+    return QSKETCH_MIN * 2.0 * exp(k * lg) / (1.0 + exp(lg));
+}
+
+
+int dist_parse(const char *text, dist_t *d)
+{
+    char kind[16];
+    double a = 0.0, b = 0.0;
+    int fields = sscanf(text, "%15[a-z]:%lf:%lf", kind, &a, &b);
+
+    if((fields == 2) && (strcmp(kind, "fixed") == 0))
+        *d = (dist_t){DIST_FIXED, a, 0.0};
+    else if((fields == 3) && (strcmp(kind, "uniform") == 0))
+        *d = (dist_t){DIST_UNIFORM, a, b};
+    else if((fields == 3) && (strcmp(kind, "normal") == 0))
+        *d = (dist_t){DIST_NORMAL, a, b};
+    else if((fields == 3) && (strcmp(kind, "lognormal") == 0))
+        *d = (dist_t){DIST_LOGNORMAL, a, b};
+    else
+    {
+        printf("Unknown distribution %s, use fixed:x, uniform:lo:hi, normal:mean:sd or lognormal:mu:sigma\n", text);
+        return -1;
+    }
+
+    if((fields == 3) && (b < ((strcmp(kind, "uniform") == 0) ? a : 0.0)))
+    {
+        printf("Distribution %s needs lo <= hi, or a spread of at least 0\n", text);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+double dist_sample(const dist_t *d, philox_t *r)
+{
+    switch(d->kind)
+    {
+        case DIST_UNIFORM:
+            return d->a + (d->b - d->a) * philox_uniform(r);
+
+        case DIST_NORMAL:
+            return d->a + d->b * philox_normal(r);
+
+        case DIST_LOGNORMAL:
+            return exp(d->a + d->b * philox_normal(r));
+
+        case DIST_FIXED:
+        default:
+            return d->a;
+    }
+}
+
+
+void dist_print(const char *name, const dist_t *d)
+{
+    static const char *kinds[] = {"fixed", "uniform", "normal", "lognormal"};
+
+    if(d->kind == DIST_FIXED)
+        printf("    %s = fixed:%lg\n", name, d->a);
+    else
+        printf("    %s = %s:%lg:%lg\n", name, kinds[d->kind], d->a, d->b);
+}
@@ -0,0 +1,82 @@
+#ifndef MONTECARLO_H
+#define MONTECARLO_H
+
+#include "philox.h"
+
+// Monte Carlo building blocks: parameter distributions drawn from philox.h streams and mergeable streaming
+// statistics
+//
+// A campaign of millions of samples can't keep the samples, so every thread accumulates into its own statistics
+// and the threads' and then the ranks' statistics are merged at the end.  Memory is constant in the number of
+// samples, and since merging is exact (moments) or bucket-wise (quantiles), the merged result is the same as one
+// accumulator seeing every sample.
+//
+
+// Running moments by Welford's algorithm, merged with Chan et al.'s pairwise update
+//
+// Reference - Chan, Golub & LeVeque, Algorithms for computing the sample variance, Am. Stat. 37(3), 1983
+//
+typedef struct
+{
+    double n, mean, m2, min, max;           // all doubles so a welford_t is an MPI_DOUBLE array
+} welford_t;
+
+void welford_init(welford_t *w);
+void welford_add(welford_t *w, double x);
+void welford_merge(welford_t *w, const welford_t *other);
+double welford_sd(const welford_t *w);
+
+
+// Quantile sketch with relative accuracy (DDSketch)
+//
+// Bucket k counts the values in (gamma^(k-1), gamma^k] with gamma = (1+alpha)/(1-alpha), so any quantile is
+// returned within a relative error alpha of the true one.  Merging adds the bucket counts, and with a fixed range
+// of buckets the sketch has a fixed size - values below QSKETCH_MIN (including zero and negatives) are counted
+// in the first bucket and values beyond the range in the last.  4096 buckets at alpha=0.5% cover 1e-6 to 1e12.
+//
+// Reference - Masson, Rim & Lee, DDSketch: a fast and fully-mergeable quantile sketch with relative-error
+// guarantees, VLDB 2019
+//
+#define QSKETCH_ALPHA (0.005)
+#define QSKETCH_BUCKETS (4096)
+#define QSKETCH_MIN (1.0e-6)
+
+typedef struct
+{
+    double count[QSKETCH_BUCKETS];          // doubles so the merge is an MPI_SUM, exact to 2^53 samples
+    double total;
+} qsketch_t;
+
+void qsketch_init(qsketch_t *s);
+void qsketch_add(qsketch_t *s, double x);
+void qsketch_merge(qsketch_t *s, const qsketch_t *other);
+
+// Value at quantile q in [0, 1], or 0.0 for an empty sketch
+double qsketch_quantile(const qsketch_t *s, double q);
+
+
+// Parameter distributions, given on the command line as
+//
+//     fixed:x   uniform:lo:hi   normal:mean:sd   lognormal:mu:sigma (of the log)
+//
+#define DIST_FIXED (0)
+#define DIST_UNIFORM (1)
+#define DIST_NORMAL (2)
+#define DIST_LOGNORMAL (3)
+
+typedef struct
+{
+    int kind;
+    double a, b;
+} dist_t;
+
+// Parse text into d - returns 0, or -1 with a message printed and d unchanged, also for hi < lo or a negative sd
+// or sigma.  A normal distribution can still draw values of either sign, so callers check what they draw.
+int dist_parse(const char *text, dist_t *d);
+
+double dist_sample(const dist_t *d, philox_t *r);
+
+// Print d as it would be parsed, for run logs
+void dist_print(const char *name, const dist_t *d);
+
+#endif
@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+
+#include "parareal.h"
+
+// Parareal parallel-in-time solver - see parareal.h
+
+
+void ode_rk4(ode_rhs *rhs, ode_project *project, void *ctx, int dim, double t0, double t1, unsigned long steps, double *y)
+{
+    double k1[DOPRI_MAX_DIM], k2[DOPRI_MAX_DIM], k3[DOPRI_MAX_DIM], k4[DOPRI_MAX_DIM], ys[DOPRI_MAX_DIM];
+    double h = (t1 - t0) / (double)steps, t;
+    unsigned long step;
+    int i;
+
+    for(step=0; step < steps; step++)
+    {
+        t = t0 + (double)step * h;
+
+        rhs(t, y, k1, ctx);
+        for(i=0; i < dim; i++) ys[i] = y[i] + 0.5*h*k1[i];
+        rhs(t + 0.5*h, ys, k2, ctx);
+        for(i=0; i < dim; i++) ys[i] = y[i] + 0.5*h*k2[i];
+        rhs(t + 0.5*h, ys, k3, ctx);
+        for(i=0; i < dim; i++) ys[i] = y[i] + h*k3[i];
+        rhs(t + h, ys, k4, ctx);
+
+        for(i=0; i < dim; i++)
+            y[i] += h*(k1[i] + 2.0*k2[i] + 2.0*k3[i] + k4[i])/6.0;
+
+        if(project != NULL)
+            project(y, ctx);
+    }
+}
+
+
+static double slice_time(const parareal_t *p, int n)
+{
+    return (n == p->slices) ? p->t1 : p->t0 + (p->t1 - p->t0) * (double)n / (double)p->slices;
+}
+
+
+void parareal_fine_range(const parareal_t *p, int first, int last, double (*U)[DOPRI_MAX_DIM], double (*F)[DOPRI_MAX_DIM], int thread_count)
+{
+    int n;
+
+    // slices all cost the same, so a static split is balanced
+    #pragma omp parallel for num_threads(thread_count) schedule(static)
+    for(n=first; n < last; n++)
+    {
+        memcpy(F[n], U[n], p->dim * sizeof(double));
+        ode_rk4(p->rhs, p->project, p->ctx, p->dim, slice_time(p, n), slice_time(p, n+1), p->fine_steps, F[n]);
+    }
+}
+
+
+void parareal_fine_omp(const parareal_t *p, int first, double (*U)[DOPRI_MAX_DIM], double (*F)[DOPRI_MAX_DIM], void *backend)
+{
+    parareal_fine_range(p, first, p->slices, U, F, *(int *)backend);
+}
+
+
+int Parareal(parareal_t *p, const double *y0, double (*U)[DOPRI_MAX_DIM], parareal_fine *fine, void *backend)
+{
+    double (*F)[DOPRI_MAX_DIM], (*G)[DOPRI_MAX_DIM];
+    double g[DOPRI_MAX_DIM], u;
+    int n, i, k;
+
+    if((p->slices < 1) || (p->slices > PARAREAL_MAX_SLICES) || (p->dim > DOPRI_MAX_DIM))
+    {
+        printf("Parareal: %d slices must be 1 to %d, and %d equations at most %d\n", p->slices, PARAREAL_MAX_SLICES,
+               p->dim, DOPRI_MAX_DIM);
+        exit(-1);
+    }
+
+    F = malloc(sizeof(double) * DOPRI_MAX_DIM * p->slices);
+    G = malloc(sizeof(double) * DOPRI_MAX_DIM * p->slices);
+
+    if((F == NULL) || (G == NULL))
+    {
+        printf("Parareal: could not allocate %d slices\n", p->slices);
+        exit(-1);
+    }
+
+    p->iterations = 0;
+    p->fine_solves = 0;
+    p->change = 0.0;
+
+    // initial coarse sweep, keeping G[n] = G(U[n]) for the first correction
+    memcpy(U[0], y0, p->dim * sizeof(double));
+    for(n=0; n < p->slices; n++)
+    {
+        memcpy(G[n], U[n], p->dim * sizeof(double));
+        ode_rk4(p->rhs, p->project, p->ctx, p->dim, slice_time(p, n), slice_time(p, n+1), p->coarse_steps, G[n]);
+        memcpy(U[n+1], G[n], p->dim * sizeof(double));
+    }
+
+    // slices before k are already exact after k iterations, so each iteration only fine solves from k on
+    for(k=0; k < p->max_iter; k++)
+    {
+        fine(p, k, U, F, backend);
+        p->fine_solves += p->slices - k;
+
+        p->change = 0.0;
+
+        // U[k+1] is now the fine solution, and the corrected sweep continues from it
+        for(n=k; n < p->slices; n++)
+        {
+            memcpy(g, U[n], p->dim * sizeof(double));
+            ode_rk4(p->rhs, p->project, p->ctx, p->dim, slice_time(p, n), slice_time(p, n+1), p->coarse_steps, g);
+
+            for(i=0; i < p->dim; i++)
+            {
+                u = g[i] + F[n][i] - G[n][i];
+
+                if(fabs(u - U[n+1][i]) > p->change)
+                    p->change = fabs(u - U[n+1][i]);
+
+                U[n+1][i] = u;
+                G[n][i] = g[i];
+            }
+        }
+
+        p->iterations = k+1;
+
+        if((p->change <= p->tol) || (k+1 == p->slices))
+            break;
+    }
+
+    free(F);
+    free(G);
+
+    return ((p->change <= p->tol) || (p->iterations == p->slices)) ? 0 : -1;
+}
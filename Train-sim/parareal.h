@@ -0,0 +1,66 @@
+#ifndef PARAREAL_H
+#define PARAREAL_H
+
+#include "dopri5.h"
+
+// Parareal parallel-in-time solver
+//
+// Once the resistance depends on velocity, dv/dt = accel(t) - r(v) is a true ODE: velocity can no longer be
+// integrated on its own and then position from it, and every step depends on the one before, so the time loop is
+// sequential.  Parareal (Lions, Maday & Turinici 2001) splits [t0, t1] into slices and iterates
+//
+//     U[n+1] = G(U[n]) + F(U_old[n]) - G(U_old[n])
+//
+// where F is the accurate fine propagator over one slice and G a cheap coarse one.  The coarse sweep is
+// sequential but cheap; the fine solves of all slices are independent and run in parallel.  After k iterations
+// the first k slices are exact (to the fine solution), and in practice the iteration converges in far fewer than
+// the number of slices, so the fine work is spread over the slices with a few times its sequential cost.
+//
+// Both propagators are fixed step RK4 here, fine_steps and coarse_steps per slice.  A fixed step can overshoot a
+// constraint of the state, like a train braking to a stop, so project (if not NULL) is applied after each step.
+//
+// Reference - Gander & Vandewalle, Analysis of the parareal time-parallel time-integration method, SIAM J. Sci.
+// Comput. 29(2), 2007
+//
+#define PARAREAL_MAX_SLICES (4096)
+
+// Put the state y back within its constraints after a step - a stopped train's velocity back to zero
+typedef void ode_project(double *y, void *ctx);
+
+typedef struct
+{
+    ode_rhs *rhs;
+    ode_project *project;                       // after each step, NULL for none
+    void *ctx;
+    int dim;
+    double t0, t1;
+    int slices;
+    unsigned long fine_steps, coarse_steps;     // per slice
+    double tol;                                 // largest change of a slice boundary state to stop at
+    int max_iter;
+
+    // Statistics
+    int iterations;
+    double change;                              // largest change in the last iteration
+    unsigned long fine_solves;
+} parareal_t;
+
+// Fine propagation of slices first..slices-1: F[n] = fine solution at the end of slice n started from U[n].  A
+// backend can split the slices across threads or ranks, as long as every caller ends up with all of F.
+typedef void parareal_fine(const parareal_t *p, int first, double (*U)[DOPRI_MAX_DIM], double (*F)[DOPRI_MAX_DIM], void *backend);
+
+// Classical RK4 from t0 to t1 in steps equal steps, advancing y in place and applying project (if not NULL) after
+// each step
+void ode_rk4(ode_rhs *rhs, ode_project *project, void *ctx, int dim, double t0, double t1, unsigned long steps, double *y);
+
+// Fine solve of slices first..last-1 only, for backends that split the slices themselves
+void parareal_fine_range(const parareal_t *p, int first, int last, double (*U)[DOPRI_MAX_DIM], double (*F)[DOPRI_MAX_DIM], int thread_count);
+
+// OpenMP backend - backend points to the int thread count
+void parareal_fine_omp(const parareal_t *p, int first, double (*U)[DOPRI_MAX_DIM], double (*F)[DOPRI_MAX_DIM], void *backend);
+
+// Solve from y0 at p->t0, leaving the state at each slice boundary in U[0..slices] - returns 0 when converged, or
+// -1 if p->max_iter iterations were not enough (U then holds the last iterate)
+int Parareal(parareal_t *p, const double *y0, double (*U)[DOPRI_MAX_DIM], parareal_fine *fine, void *backend);
+
+#endif
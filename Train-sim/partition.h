@@ -0,0 +1,157 @@
+#ifndef PARTITION_H
+#define PARTITION_H
+
+#include <stdio.h>
+#include <string.h>
+#include <omp.h>
+
+// Work partitioner for splitting a range of steps or nodes across the threads of an OpenMP team
+//
+// The Local_* integrators used to take local_n = n / thread_count steps each, silently dropping the remainder
+// whenever the thread count does not divide n.  Every parallel loop now gets its share of [first, last) from here:
+//
+//     static   one contiguous block per thread, with the remainder spread one each over the first threads, so
+//              blocks differ by at most one - the only policy that keeps blocks in thread order, as the prefix
+//              scans need
+//     dynamic  chunks of a fixed size handed out first come first served
+//     guided   chunks of half the remaining work per thread, shrinking to a minimum size
+//
+// Dynamic and guided balance load when threads are not equally fast, e.g. oversubscribed or sharing cores with
+// MPI ranks.  A thread claims its pieces with
+//
+//     static partition_t part;                   // shared by the team
+//     unsigned long first, last, claimed=0;
+//
+//     partition_begin(&part, 0, n, schedule);    // every thread in the team
+//     while(partition_next(&part, &claimed, &first, &last))
+//         ... work on [first, last) ...
+//
+#define PARTITION_STATIC (0)
+#define PARTITION_DYNAMIC (1)
+#define PARTITION_GUIDED (2)
+
+// Chunk size for dynamic, and smallest chunk for guided, when none is given
+#define PARTITION_DEFAULT_CHUNK (1024)
+
+typedef struct
+{
+    int policy;
+    unsigned long chunk;                // 0 for PARTITION_DEFAULT_CHUNK, not used by static
+} partition_schedule_t;
+
+typedef struct
+{
+    unsigned long first, last;          // whole range
+    unsigned long next;                 // first unclaimed index for dynamic and guided
+    partition_schedule_t schedule;
+} partition_t;
+
+
+// Block rank of nthreads of [first, last) for the static policy
+static inline void partition_static_range(unsigned long first, unsigned long last, int rank, int nthreads,
+                                          unsigned long *my_first, unsigned long *my_last)
+{
+    unsigned long n = last - first, base = n / (unsigned long)nthreads, extra = n % (unsigned long)nthreads;
+    unsigned long r = (unsigned long)rank;
+
+    *my_first = first + r*base + (r < extra ? r : extra);
+    *my_last = *my_first + base + (r < extra ? 1 : 0);
+}
+
+
+// Set up p for the team - called by every thread of the team, with p in shared storage
+//
+// The barrier before the set-up keeps it from resetting p while another thread is still claiming from an earlier
+// use of it, and the single's own barrier publishes it before anyone claims.
+//
+static inline void partition_begin(partition_t *p, unsigned long first, unsigned long last, partition_schedule_t schedule)
+{
+    #pragma omp barrier
+
+    #pragma omp single
+    {
+        p->first = first;
+        p->last = last;
+        p->next = first;
+        p->schedule = schedule;
+
+        if(p->schedule.chunk == 0)
+            p->schedule.chunk = PARTITION_DEFAULT_CHUNK;
+    }
+}
+
+
+// Claim the calling thread's next piece [*first, *last) of p - returns 0 when there is no more work
+//
+// *claimed counts the pieces this thread has claimed so far and must start at 0.
+//
+static inline int partition_next(partition_t *p, unsigned long *claimed, unsigned long *first, unsigned long *last)
+{
+    unsigned long start, size, remaining;
+    int nthreads = omp_get_num_threads();
+
+    switch(p->schedule.policy)
+    {
+        case PARTITION_DYNAMIC:
+            #pragma omp atomic capture
+            { start = p->next; p->next += p->schedule.chunk; }
+
+            size = p->schedule.chunk;
+            break;
+
+        case PARTITION_GUIDED:
+            #pragma omp critical (partition_guided)
+            {
+                start = p->next;
+                remaining = (start < p->last) ? p->last - start : 0;
+                size = remaining / (2*(unsigned long)nthreads);
+                if(size < p->schedule.chunk) size = p->schedule.chunk;
+                p->next = start + size;
+            }
+            break;
+
+        case PARTITION_STATIC:
+        default:
+            if(*claimed > 0) return 0;
+
+            partition_static_range(p->first, p->last, omp_get_thread_num(), nthreads, first, last);
+            (*claimed)++;
+            return (*last > *first);
+    }
+
+    if(start >= p->last) return 0;
+
+    *first = start;
+    *last = (p->last - start < size) ? p->last : start + size;
+    (*claimed)++;
+
+    return 1;
+}
+
+
+// Schedule from --schedule=static|dynamic|guided and --chunk=size, either of which may be NULL for the default -
+// returns 0, or -1 for an unknown policy
+static inline int partition_parse(const char *policy, const char *chunk, partition_schedule_t *schedule)
+{
+    schedule->policy = PARTITION_STATIC;
+    schedule->chunk = 0;
+
+    if(chunk != NULL)
+        sscanf(chunk, "%lu", &schedule->chunk);
+
+    if((policy == NULL) || (strcmp(policy, "static") == 0))
+        return 0;
+    else if(strcmp(policy, "dynamic") == 0)
+        schedule->policy = PARTITION_DYNAMIC;
+    else if(strcmp(policy, "guided") == 0)
+        schedule->policy = PARTITION_GUIDED;
+    else
+    {
+        printf("Unknown schedule %s, use static, dynamic or guided\n", policy);
+        return -1;
+    }
+
+    return 0;
+}
+
+#endif
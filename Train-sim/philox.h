@@ -0,0 +1,173 @@
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <stdint.h>
+#include <math.h>
+
+// Counter-based random numbers - Philox4x32-10
+//
+// A counter-based generator has no state to advance: number k of a stream is a fixed function of (key, counter),
+// here 10 rounds of multiply and xor over a 128-bit counter with a 64-bit key.  The key is the seed and the counter
+// is (block, stream), both 64 bits, so every stream is its own independent sequence of 2^64 blocks of two 64-bit
+// words, and any number of it can be computed directly without drawing the ones before.
+//
+// Streams are whatever the caller numbers them by.  Numbered by trial, a Monte Carlo sample draws the same numbers
+// whichever rank or thread runs it, so results are reproducible for any decomposition; for a stream per worker
+// instead, philox_stream_id(rank, thread) numbers them apart from any trial number below 2^63.
+//
+// Header only, for C and C++, so the Train-sim drivers and the GMAT wrapper share it.  philox_t draws one number
+// at a time; the fill functions compute a run of numbers of one stream with independent iterations, so they
+// vectorize (8 blocks per AVX-512 multiply) when compiled with optimization and OpenMP simd.
+//
+// Reference - Salmon, Moraes, Dror & Shaw, Parallel random numbers: as easy as 1, 2, 3, SC 2011
+//
+#define PHILOX_M0 (0xD2511F53U)
+#define PHILOX_M1 (0xCD9E8D57U)
+#define PHILOX_W0 (0x9E3779B9U)
+#define PHILOX_W1 (0xBB67AE85U)
+
+#define PHILOX_TWO_PI (6.283185307179586476925286766559)
+
+typedef struct
+{
+    uint64_t seed, stream;
+    uint64_t block;                         // next block to compute
+    uint64_t word[2];                       // the current block
+    int used;                               // words of the current block already returned, 2 when empty
+    int have_normal;                        // the second normal of the last Box-Muller pair is waiting
+    double normal;
+} philox_t;
+
+
+// One round, then the key bump - a macro over scalars rather than a function over arrays, so nothing is left in
+// memory to stop the fill loops vectorizing
+#define PHILOX_ROUND(c0, c1, c2, c3, k0, k1)                                                                       \
+    {                                                                                                              \
+        uint64_t p0 = (uint64_t)PHILOX_M0 * c0, p1 = (uint64_t)PHILOX_M1 * c2;                                     \
+        c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0; c1 = (uint32_t)p1;                                                    \
+        c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1; c3 = (uint32_t)p0;                                                    \
+        k0 += PHILOX_W0; k1 += PHILOX_W1;                                                                          \
+    }
+
+// Block number block of stream of seed after 10 rounds, as two 64-bit words
+static inline void philox_block(uint64_t seed, uint64_t stream, uint64_t block, uint64_t *word0, uint64_t *word1)
+{
+    uint32_t c0 = (uint32_t)block, c1 = (uint32_t)(block >> 32), c2 = (uint32_t)stream, c3 = (uint32_t)(stream >> 32);
+    uint32_t k0 = (uint32_t)seed, k1 = (uint32_t)(seed >> 32);
+
+    PHILOX_ROUND(c0, c1, c2, c3, k0, k1) PHILOX_ROUND(c0, c1, c2, c3, k0, k1) PHILOX_ROUND(c0, c1, c2, c3, k0, k1)
+    PHILOX_ROUND(c0, c1, c2, c3, k0, k1) PHILOX_ROUND(c0, c1, c2, c3, k0, k1) PHILOX_ROUND(c0, c1, c2, c3, k0, k1)
+    PHILOX_ROUND(c0, c1, c2, c3, k0, k1) PHILOX_ROUND(c0, c1, c2, c3, k0, k1) PHILOX_ROUND(c0, c1, c2, c3, k0, k1)
+    PHILOX_ROUND(c0, c1, c2, c3, k0, k1)
+
+    *word0 = (uint64_t)c0 | ((uint64_t)c1 << 32);
+    *word1 = (uint64_t)c2 | ((uint64_t)c3 << 32);
+}
+
+// Top 53 bits on (0, 1), offset by half an ulp so 0 and 1 are never returned
+static inline double philox_to_uniform(uint64_t x)
+{
+    return ((double)(x >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+// Normal number which (0 or 1) of the Box-Muller pair of u1 and u2 - sin(angle) is cos(angle - pi/2), so either
+// is one call with no branch
+static inline double philox_box_muller(double u1, double u2, int which)
+{
+    return sqrt(-2.0 * log(u1)) * cos(PHILOX_TWO_PI * u2 - (double)which * (0.25 * PHILOX_TWO_PI));
+}
+
+// Stream per (rank, thread), with the top bit set so it is never a trial number below 2^63
+static inline uint64_t philox_stream_id(int rank, int thread)
+{
+    return (UINT64_C(1) << 63) | ((uint64_t)(uint32_t)rank << 24) | (uint64_t)(uint32_t)thread;
+}
+
+// Start at number 0 of stream of seed
+static inline void philox_init(philox_t *r, uint64_t seed, uint64_t stream)
+{
+    r->seed = seed;
+    r->stream = stream;
+    r->block = 0;
+    r->used = 2;
+    r->have_normal = 0;
+}
+
+static inline uint64_t philox_next(philox_t *r)
+{
+    if(r->used == 2)
+    {
+        philox_block(r->seed, r->stream, r->block++, &r->word[0], &r->word[1]);
+        r->used = 0;
+    }
+
+    return r->word[r->used++];
+}
+
+// Uniform on (0, 1) - number k is philox_uniform_fill()'s out[k] from first=0
+static inline double philox_uniform(philox_t *r)
+{
+    return philox_to_uniform(philox_next(r));
+}
+
+// Standard normal, one Box-Muller pair per block - from a fresh stream, number k is philox_normal_fill()'s out[k]
+// from first=0, to the rounding of log and cos
+static inline double philox_normal(philox_t *r)
+{
+    double u1, u2;
+
+    if(r->have_normal)
+    {
+        r->have_normal = 0;
+        return r->normal;
+    }
+
+    // both words of one block
+    r->used = 2;
+    u1 = philox_uniform(r);
+    u2 = philox_uniform(r);
+
+    r->normal = philox_box_muller(u1, u2, 1);
+    r->have_normal = 1;
+    return philox_box_muller(u1, u2, 0);
+}
+
+// Uniform numbers first .. first+n-1 of a stream into out, two per block
+static inline void philox_uniform_fill(uint64_t seed, uint64_t stream, uint64_t first, double *out, long n)
+{
+    long i;
+
+#ifdef _OPENMP
+    #pragma omp simd
+#endif
+    for(i=0; i < n; i++)
+    {
+        uint64_t number = first + (uint64_t)i, word0, word1;
+
+        philox_block(seed, stream, number >> 1, &word0, &word1);
+
+        // a select rather than a branch, so the loop vectorizes
+        out[i] = philox_to_uniform((number & 1) ? word1 : word0);
+    }
+}
+
+// Standard normal numbers first .. first+n-1 of a stream into out, each Box-Muller pair from one block - the
+// generator vectorizes, and log and cos do too where the vector math library is allowed (-ffast-math)
+static inline void philox_normal_fill(uint64_t seed, uint64_t stream, uint64_t first, double *out, long n)
+{
+    long i;
+
+#ifdef _OPENMP
+    #pragma omp simd
+#endif
+    for(i=0; i < n; i++)
+    {
+        uint64_t number = first + (uint64_t)i, word0, word1;
+
+        philox_block(seed, stream, number >> 1, &word0, &word1);
+
+        out[i] = philox_box_muller(philox_to_uniform(word0), philox_to_uniform(word1), (int)(number & 1));
+    }
+}
+
+#endif
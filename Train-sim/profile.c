@@ -0,0 +1,277 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "profile.h"
+
+// Memory-mapped binary train profiles - see profile.h for the file layout
+
+
+static uint64_t data_offset(void)
+{
+    uint64_t hsize = sizeof(profile_header_t);
+
+    return ((hsize + PROFILE_DATA_ALIGN - 1) / PROFILE_DATA_ALIGN) * PROFILE_DATA_ALIGN;
+}
+
+
+uint64_t profile_checksum(uint64_t hash, const double *data, uint64_t count)
+{
+    const uint64_t *word = (const uint64_t *)data;
+    uint64_t idx;
+
+    for(idx=0; idx < count; idx++)
+    {
+        hash ^= word[idx];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+
+int profile_open(const char *path, profile_t *prof, int verify)
+{
+    struct stat st;
+    profile_header_t *hdr;
+    uint64_t offset, hash, col;
+
+    memset(prof, 0, sizeof(profile_t));
+    prof->fd = -1;
+
+    if((prof->fd = open(path, O_RDONLY)) < 0)
+    {
+        printf("Error opening profile %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    if((fstat(prof->fd, &st) < 0) || (st.st_size < (off_t)sizeof(profile_header_t)))
+    {
+        printf("Profile %s is too small to hold a header\n", path);
+        profile_close(prof);
+        return -1;
+    }
+
+    prof->map_size = st.st_size;
+    prof->map = mmap(NULL, prof->map_size, PROT_READ, MAP_SHARED, prof->fd, 0);
+
+    if(prof->map == MAP_FAILED)
+    {
+        printf("Error mapping profile %s: %s\n", path, strerror(errno));
+        prof->map = NULL;
+        profile_close(prof);
+        return -1;
+    }
+
+    hdr = prof->header = (profile_header_t *)prof->map;
+
+    if(memcmp(hdr->magic, PROFILE_MAGIC, 4) != 0)
+    {
+        printf("Profile %s is not a train profile (bad magic)\n", path);
+        profile_close(prof);
+        return -1;
+    }
+
+    if((hdr->version != PROFILE_VERSION) || (hdr->header_size != sizeof(profile_header_t)))
+    {
+        printf("Profile %s is version %u, expected version %d\n", path, hdr->version, PROFILE_VERSION);
+        profile_close(prof);
+        return -1;
+    }
+
+    if((hdr->ncolumns == 0) || (hdr->ncolumns > PROFILE_MAX_COLUMNS) || (hdr->count == 0) || !(hdr->sample_rate > 0.0))
+    {
+        printf("Profile %s has an invalid header: %u columns, %lu samples, %lf Hz\n",
+               path, hdr->ncolumns, (unsigned long)hdr->count, hdr->sample_rate);
+        profile_close(prof);
+        return -1;
+    }
+
+    // Every column must be aligned for doubles and lie entirely within the file - the count is compared against
+    // the room after the offset, since offset + count*8 can wrap for a corrupt header
+    for(col=0; col < hdr->ncolumns; col++)
+    {
+        offset = hdr->column[col].offset;
+
+        if((offset < sizeof(profile_header_t)) || (offset > prof->map_size) || (offset % sizeof(double) != 0) ||
+           (hdr->count > (prof->map_size - offset) / sizeof(double)))
+        {
+            printf("Profile %s is truncated or corrupt: column %lu at offset %lu needs %lu samples, file has %lu bytes\n",
+                   path, (unsigned long)col, (unsigned long)offset, (unsigned long)hdr->count,
+                   (unsigned long)prof->map_size);
+            profile_close(prof);
+            return -1;
+        }
+    }
+
+    if(verify)
+    {
+        hash = PROFILE_CHECKSUM_INIT;
+
+        for(col=0; col < hdr->ncolumns; col++)
+            hash = profile_checksum(hash, (const double *)((char *)prof->map + hdr->column[col].offset), hdr->count);
+
+        if(hash != hdr->checksum)
+        {
+            printf("Profile %s checksum mismatch: header %016lx, data %016lx\n",
+                   path, (unsigned long)hdr->checksum, (unsigned long)hash);
+            profile_close(prof);
+            return -1;
+        }
+    }
+
+    // Simulation sweeps the table front to back
+    madvise(prof->map, prof->map_size, MADV_SEQUENTIAL);
+
+    return 0;
+}
+
+
+int profile_create(const char *path, profile_t *prof, uint32_t ncolumns, const uint32_t *kinds,
+                   const uint32_t *units, uint64_t count, double sample_rate)
+{
+    profile_header_t *hdr;
+    uint64_t col;
+
+    memset(prof, 0, sizeof(profile_t));
+    prof->fd = -1;
+
+    if((ncolumns == 0) || (ncolumns > PROFILE_MAX_COLUMNS) || (count == 0) || !(sample_rate > 0.0))
+    {
+        printf("Cannot create profile %s with %u columns, %lu samples, %lf Hz\n",
+               path, ncolumns, (unsigned long)count, sample_rate);
+        return -1;
+    }
+
+    if((prof->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0)
+    {
+        printf("Error creating profile %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    prof->map_size = data_offset() + (size_t)ncolumns * count * sizeof(double);
+
+    if(ftruncate(prof->fd, prof->map_size) < 0)
+    {
+        printf("Error sizing profile %s to %lu bytes: %s\n", path, (unsigned long)prof->map_size, strerror(errno));
+        profile_close(prof);
+        return -1;
+    }
+
+    prof->map = mmap(NULL, prof->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, prof->fd, 0);
+
+    if(prof->map == MAP_FAILED)
+    {
+        printf("Error mapping profile %s: %s\n", path, strerror(errno));
+        prof->map = NULL;
+        profile_close(prof);
+        return -1;
+    }
+
+    prof->writable = 1;
+    hdr = prof->header = (profile_header_t *)prof->map;
+
+    // magic stays zero until profile_finish()
+    hdr->version = PROFILE_VERSION;
+    hdr->header_size = sizeof(profile_header_t);
+    hdr->ncolumns = ncolumns;
+    hdr->count = count;
+    hdr->sample_rate = sample_rate;
+
+    for(col=0; col < ncolumns; col++)
+    {
+        hdr->column[col].kind = kinds[col];
+        hdr->column[col].units = units[col];
+        hdr->column[col].offset = data_offset() + col * count * sizeof(double);
+    }
+
+    return 0;
+}
+
+
+int profile_finish(profile_t *prof)
+{
+    profile_header_t *hdr = prof->header;
+    uint64_t hash = PROFILE_CHECKSUM_INIT, col, idx;
+
+    if(!prof->writable)
+    {
+        printf("profile_finish: profile is not open for writing\n");
+        return -1;
+    }
+
+    for(col=0; col < hdr->ncolumns; col++)
+    {
+        const double *data = (const double *)((char *)prof->map + hdr->column[col].offset);
+        double min = data[0], max = data[0], sum = 0.0, sumsq = 0.0, mean;
+
+        #pragma omp parallel for reduction(min:min) reduction(max:max) reduction(+:sum)
+        for(idx=0; idx < hdr->count; idx++)
+        {
+            if(data[idx] < min) min = data[idx];
+            if(data[idx] > max) max = data[idx];
+            sum += data[idx];
+        }
+
+        mean = sum / (double)hdr->count;
+
+        // second pass about the mean rather than sum of squares, which cancels badly for near-constant columns
+        #pragma omp parallel for reduction(+:sumsq)
+        for(idx=0; idx < hdr->count; idx++)
+            sumsq += (data[idx] - mean) * (data[idx] - mean);
+
+        hdr->column[col].min = min;
+        hdr->column[col].max = max;
+        hdr->column[col].mean = mean;
+        hdr->column[col].stddev = sqrt(sumsq / (double)hdr->count);
+
+        hash = profile_checksum(hash, data, hdr->count);
+    }
+
+    hdr->checksum = hash;
+
+    // Make sure the data is on disk before the magic marks it valid
+    if(msync(prof->map, prof->map_size, MS_SYNC) < 0)
+    {
+        printf("Error writing profile: %s\n", strerror(errno));
+        return -1;
+    }
+
+    memcpy(hdr->magic, PROFILE_MAGIC, 4);
+
+    return msync(prof->map, PROFILE_DATA_ALIGN, MS_SYNC);
+}
+
+
+void profile_close(profile_t *prof)
+{
+    if(prof->map != NULL)
+        munmap(prof->map, prof->map_size);
+
+    if(prof->fd >= 0)
+        close(prof->fd);
+
+    prof->map = NULL;
+    prof->header = NULL;
+    prof->fd = -1;
+}
+
+
+double *profile_column(const profile_t *prof, uint32_t kind)
+{
+    uint32_t col;
+
+    for(col=0; col < prof->header->ncolumns; col++)
+    {
+        if(prof->header->column[col].kind == kind)
+            return (double *)((char *)prof->map + prof->header->column[col].offset);
+    }
+
+    return NULL;
+}
@@ -0,0 +1,106 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Binary train profile format
+//
+// The DefaultProfile[] headers (ex3.h, ex4.h, const.h, sine.h) have to be compiled in, so every route change
+// means a rebuild.  A binary profile is instead memory-mapped at startup, and since the samples are stored as
+// native doubles, one column after another, a column can be used directly from the mapping with no parsing
+// and no copy - the OS pages in only what the simulation touches, so multi-GB profiles load instantly.
+//
+// File layout (native byte order, which is little-endian on every machine we run on):
+//
+//     [profile_header_t][pad to PROFILE_DATA_ALIGN][column 0: count doubles][column 1: count doubles]...
+//
+// The checksum covers all column data, and the magic is written last by profile_finish(), so a conversion
+// that dies part way through never leaves a file that looks valid.
+//
+#define PROFILE_MAGIC "TRPF"
+#define PROFILE_VERSION (1)
+#define PROFILE_MAX_COLUMNS (8)
+#define PROFILE_DATA_ALIGN (4096)
+
+// What a column holds
+#define PROFILE_COL_ACCEL (1)
+#define PROFILE_COL_GRADE (2)
+#define PROFILE_COL_SPEED_LIMIT (3)
+
+// Time of each sample in seconds, strictly increasing, for samples taken at irregular or mixed rates - without
+// one, sample i is at i/sample_rate
+#define PROFILE_COL_TIME (4)
+
+// Per-interval slope of another column, (x[i+1]-x[i])/sample_period, or divided by the time between the samples
+// with a time column, with the last entry 0.0
+#define PROFILE_COL_SLOPE (0x100)
+#define PROFILE_SLOPE_OF(kind) (PROFILE_COL_SLOPE | (kind))
+
+// Units of a column
+#define PROFILE_UNITS_NONE (0)
+#define PROFILE_UNITS_MPS2 (1)      // meters/sec^2
+#define PROFILE_UNITS_PERCENT (2)   // grade as rise/run * 100
+#define PROFILE_UNITS_MPS (3)       // meters/sec
+#define PROFILE_UNITS_SECONDS (4)
+
+// Units of a slope column are the units of its source column per second
+#define PROFILE_UNITS_PER_SECOND (0x100)
+
+typedef struct
+{
+    uint32_t kind;                  // PROFILE_COL_*
+    uint32_t units;                 // PROFILE_UNITS_*
+    uint64_t offset;                // byte offset of the column from the start of the file
+    double min, max, mean, stddev;  // summary statistics filled in by profile_finish()
+} profile_column_t;
+
+typedef struct
+{
+    char magic[4];                  // PROFILE_MAGIC
+    uint32_t version;               // PROFILE_VERSION
+    uint32_t header_size;           // sizeof(profile_header_t) for this version
+    uint32_t ncolumns;
+    uint64_t count;                 // samples in every column
+    double sample_rate;             // samples per second, 1.0 for the 1 Hz spreadsheet profiles - the mean with a time column
+    uint64_t reserved0;             // zero - sample 0 is at time 0, or at the first entry of the time column
+    uint64_t checksum;              // profile_checksum() over all column data in column order
+    uint64_t reserved[3];
+    profile_column_t column[PROFILE_MAX_COLUMNS];
+} profile_header_t;
+
+// An open profile, either mapped read-only by profile_open() or read-write by profile_create()
+typedef struct
+{
+    profile_header_t *header;
+    void *map;
+    size_t map_size;
+    int fd;
+    int writable;
+} profile_t;
+
+// Map an existing profile read-only, checking the header and, if verify is non-zero, the checksum
+//
+// Returns 0 on success, or -1 with a message printed if the file is missing, truncated, or corrupt
+//
+int profile_open(const char *path, profile_t *prof, int verify);
+
+// Create (or replace) a profile file sized for ncolumns of count samples and map it read-write
+//
+// The caller fills in the columns from profile_column() and then calls profile_finish() to compute the
+// statistics and checksum and mark the file valid.
+//
+int profile_create(const char *path, profile_t *prof, uint32_t ncolumns, const uint32_t *kinds,
+                   const uint32_t *units, uint64_t count, double sample_rate);
+int profile_finish(profile_t *prof);
+
+void profile_close(profile_t *prof);
+
+// Column of the given PROFILE_COL_* kind, or NULL if the profile does not have one
+double *profile_column(const profile_t *prof, uint32_t kind);
+
+// FNV-1a over 64-bit words, continuing from a previous hash (start with PROFILE_CHECKSUM_INIT)
+#define PROFILE_CHECKSUM_INIT (0xcbf29ce484222325ULL)
+uint64_t profile_checksum(uint64_t hash, const double *data, uint64_t count);
+
+#endif
@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+
+#include "quadrature.h"
+
+// Extrapolated quadrature rules - see quadrature.h
+
+
+double Romberg(double a, double b, double func(double), double tol, int thread_count, romberg_t *r)
+{
+    double row[ROMBERG_MAX_LEVELS], prev[ROMBERG_MAX_LEVELS];
+    double h = b - a, midsum, pow4;
+    unsigned long k, nnew;
+    int level, j;
+    romberg_t local;
+
+    if(r == NULL) r = &local;
+    memset(r, 0, sizeof(romberg_t));
+
+    prev[0] = r->trap[0] = r->extrap[0] = h * (func(a) + func(b)) / 2.0;
+    r->evaluations = 2;
+    r->levels = 1;
+
+    for(level=1; level < ROMBERG_MAX_LEVELS; level++)
+    {
+        // 2^(level-1) new midpoints of the previous grid
+        nnew = 1UL << (level-1);
+        h = h / 2.0;
+        midsum = 0.0;
+
+        #pragma omp parallel for num_threads(thread_count) reduction(+:midsum)
+        for(k=0; k < nnew; k++)
+            midsum += func(a + (double)(2*k+1)*h);
+
+        r->evaluations += nnew;
+
+        row[0] = prev[0] / 2.0 + h * midsum;
+
+        for(j=1, pow4=4.0; j <= level; j++, pow4 *= 4.0)
+            row[j] = row[j-1] + (row[j-1] - prev[j-1]) / (pow4 - 1.0);
+
+        r->trap[level] = row[0];
+        r->extrap[level] = row[level];
+        r->error = fabs(row[level] - prev[level-1]);
+        r->levels = level+1;
+
+        if((level+1 >= ROMBERG_MIN_LEVELS) && (r->error <= tol))
+            break;
+
+        memcpy(prev, row, (level+1) * sizeof(double));
+    }
+
+    return r->extrap[r->levels-1];
+}
+
+
+void Romberg_Print(const char *label, double a, double b, const romberg_t *r)
+{
+    int level;
+
+    printf("Romberg %s: %d levels, %lu evaluations, error estimate %le\n", label, r->levels, r->evaluations, r->error);
+
+    for(level=0; level < r->levels; level++)
+        printf("    level %2d dt=%le trapezoidal=%.12lf extrapolated=%.12lf\n",
+               level, (b - a) / (double)(1UL << level), r->trap[level], r->extrap[level]);
+}
+
+
+void Gauss_Legendre_Nodes(int order, double *x, double *w)
+{
+    double z, z1, p1, p2, p3, pp;
+    int i, j, half = (order + 1) / 2;
+
+    // roots are symmetric about 0, so find the positive half and mirror them
+    for(i=0; i < half; i++)
+    {
+        z = cos(M_PI * (i + 0.75) / (order + 0.5));
+
+        do
+        {
+            // P_order(z) by the three term recurrence, and its derivative from P_order and P_order-1
+            p1 = 1.0; p2 = 0.0;
+            for(j=1; j <= order; j++)
+            {
+                p3 = p2; p2 = p1;
+                p1 = ((2.0*j - 1.0)*z*p2 - (j - 1.0)*p3) / j;
+            }
+            pp = order * (z*p1 - p2) / (z*z - 1.0);
+
+            z1 = z;
+            z = z1 - p1/pp;
+        } while(fabs(z - z1) > 1.0e-15);
+
+        x[i] = -z;
+        x[order-1-i] = z;
+        w[i] = w[order-1-i] = 2.0 / ((1.0 - z*z)*pp*pp);
+    }
+}
+
+
+double Gauss_Legendre(double a, double b, double func(double), int order, unsigned long panels, int thread_count)
+{
+    double x[GAUSS_MAX_ORDER], w[GAUSS_MAX_ORDER];
+    double h = (b - a) / (double)panels, half_h = h / 2.0, sum = 0.0;
+    unsigned long panel;
+
+    if((order < 1) || (order > GAUSS_MAX_ORDER))
+    {
+        printf("Gauss_Legendre: order %d must be 1 to %d\n", order, GAUSS_MAX_ORDER);
+        exit(-1);
+    }
+
+    if(panels < 1)
+    {
+        printf("Gauss_Legendre: panels %lu must be at least 1\n", panels);
+        exit(-1);
+    }
+
+    Gauss_Legendre_Nodes(order, x, w);
+
+    #pragma omp parallel for num_threads(thread_count) reduction(+:sum)
+    for(panel=0; panel < panels; panel++)
+    {
+        double mid = a + ((double)panel + 0.5)*h, panel_sum = 0.0;
+        int node;
+
+        for(node=0; node < order; node++)
+            panel_sum += w[node] * func(mid + half_h*x[node]);
+
+        sum += panel_sum;
+    }
+
+    return half_h * sum;
+}
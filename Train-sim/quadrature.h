@@ -0,0 +1,62 @@
+#ifndef QUADRATURE_H
+#define QUADRATURE_H
+
+// Extrapolated quadrature rules for smooth integrands such as the ex3 oracles
+//
+// Romberg integration
+//
+// A convergence study reruns the trapezoidal rule with dt halved each time, throwing away the samples of every
+// coarser run.  Romberg's method keeps them: with T(k) the trapezoidal estimate on 2^k intervals,
+//
+//     T(k) = T(k-1)/2 + h(k) * sum of f at the 2^(k-1) new midpoints
+//
+// so each level costs only the new samples, and Richardson extrapolation of the T(k) column
+//
+//     R(k,j) = R(k,j-1) + (R(k,j-1) - R(k-1,j-1)) / (4^j - 1)
+//
+// cancels the h^2, h^4, ... error terms.  Levels are added until two successive diagonal entries R(k,k) agree to
+// within the tolerance.  The midpoint sum of each level is an OpenMP reduction.
+//
+// Reference - Burden & Faires, Numerical Analysis, section 4.5
+//
+// Gauss-Legendre quadrature
+//
+// An order m rule places m nodes at the roots of the Legendre polynomial P_m on each panel, integrating
+// polynomials of degree 2m-1 exactly, so a smooth integrand needs only a few panels - the panels are independent and
+// are split across OpenMP threads.  The nodes and weights are found by Newton iteration on P_m from the Chebyshev
+// estimate of each root, to full double precision for any order up to GAUSS_MAX_ORDER.
+//
+// Reference - Press et al., Numerical Recipes in C, 2nd ed., section 4.5 (gauleg)
+//
+#define ROMBERG_MAX_LEVELS (30)
+
+// At least this many levels are taken before testing convergence - a periodic integrand such as ex3_accel over
+// whole periods samples to the same value on the first few grids, which would otherwise look converged
+#define ROMBERG_MIN_LEVELS (4)
+
+typedef struct
+{
+    int levels;                             // levels computed, T(0) .. T(levels-1)
+    unsigned long evaluations;
+    double trap[ROMBERG_MAX_LEVELS];        // T(k) on 2^k intervals - the dt-halving sweep
+    double extrap[ROMBERG_MAX_LEVELS];      // R(k,k)
+    double error;                           // |R(k,k) - R(k-1,k-1)| at the last level
+} romberg_t;
+
+// Integrate func over [a, b] until successive extrapolations agree to within tol, or ROMBERG_MAX_LEVELS is reached
+// - returns R(k,k) for the last level and fills in r if it is not NULL
+double Romberg(double a, double b, double func(double), double tol, int thread_count, romberg_t *r);
+
+// Print the table of trapezoidal and extrapolated estimates by level, with the dt of each level
+void Romberg_Print(const char *label, double a, double b, const romberg_t *r);
+
+#define GAUSS_MAX_ORDER (64)
+
+// Nodes x[0..order-1] on [-1, 1] and their weights w[0..order-1] for an order point rule
+void Gauss_Legendre_Nodes(int order, double *x, double *w);
+
+// Integrate func over [a, b] with an order point rule on each of panels equal panels, with thread_count threads
+// - order must be 1 to GAUSS_MAX_ORDER and panels at least 1, or it exits with a message
+double Gauss_Legendre(double a, double b, double func(double), int order, unsigned long panels, int thread_count);
+
+#endif
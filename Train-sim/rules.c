@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include "rules.h"
+
+// Integration rules over a global node grid - see rules.h
+
+
+double Rule_Interior(int integrator, double a, double g, unsigned long first, unsigned long last, double funct(double))
+{
+    double sum = 0.0;
+    unsigned long idx;
+
+    for(idx=first; idx < last; idx++)
+        sum += rule_weight(integrator, idx) * funct(a + (double)idx*g);
+
+    return sum;
+}
+
+
+double Rule_Integrate(int integrator, double a, double b, unsigned long n, double funct(double))
+{
+    const rule_t *rule = rule_get(integrator);
+    unsigned long N = rule_intervals(integrator, n);
+    double g, sum;
+
+    if(n == 0) return 0.0;
+
+    g = (b - a) / (double)N;
+    sum = rule->w_a*funct(a) + rule->w_b*funct(b) + Rule_Interior(integrator, a, g, 1, N, funct);
+
+    return rule->factor * g * sum;
+}
+
+
+double Local_Rule(int integrator, double a, double b, unsigned long n, double funct(double), partition_schedule_t schedule)
+{
+    static partition_t part;
+    const rule_t *rule = rule_get(integrator);
+    unsigned long N = rule_intervals(integrator, n), first, last, claimed=0;
+    double g, sum = 0.0;
+
+    if(n == 0) return 0.0;
+
+    g = (b - a) / (double)N;
+
+    // the end points go to one thread, the interior nodes 1..N-1 to whoever claims them
+    if(omp_get_thread_num() == 0)
+        sum = rule->w_a*funct(a) + rule->w_b*funct(b);
+
+    partition_begin(&part, 1, N, schedule);
+
+    while(partition_next(&part, &claimed, &first, &last))
+        sum += Rule_Interior(integrator, a, g, first, last, funct);
+
+    return rule->factor * g * sum;
+}
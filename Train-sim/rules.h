@@ -0,0 +1,66 @@
+#ifndef RULES_H
+#define RULES_H
+
+#include "partition.h"
+
+// Integration rules as weighted sums over a global node grid
+//
+// The same formulation as integrators.hpp, for the C drivers: each rule is a weighted sum over a uniform grid of
+// N=n*refine intervals of width g,
+//
+//     integral = factor * g * ( w_a*f(a) + sum(i=1..N-1) weight(i)*f(a+i*g) + w_b*f(b) )
+//
+// Because the weight of a node depends only on its global index, any partition of the interior nodes among
+// threads gives the same sum as one thread would, so the result no longer depends on the thread count, and the
+// rules are the textbook composite ones:
+//
+//     Riemann       right endpoint sum, as before
+//     Trapezoidal   as before
+//     Simpson       1, 4, 2, ..., 4, 1 - the per-thread version dropped f(a) and restarted the pattern on each slice
+//     RK4           k1 + 2*k2 + 2*k3 + k4 with k2 == k3 is Simpson's rule on the half-step grid - the per-step
+//                   version evaluated its stages at t+dt, t+3dt/2 and t+2dt, one step late
+//
+// integrator is the drivers' 0=Riemann, 1=Trap, 2=Simpson, 3=RK4
+//
+typedef struct
+{
+    unsigned long refine;
+    double factor, w_a, w_b;
+} rule_t;
+
+static const rule_t Rules[4] =
+{
+    {1, 1.0,     0.0, 1.0},             // Riemann
+    {1, 1.0,     0.5, 0.5},             // Trapezoidal
+    {1, 1.0/3.0, 1.0, 1.0},             // Simpson, on an even number of intervals
+    {2, 1.0/3.0, 1.0, 1.0}              // RK4
+};
+
+static inline const rule_t *rule_get(int integrator)
+{
+    return &Rules[((integrator < 0) || (integrator > 3)) ? 0 : integrator];
+}
+
+// Number of grid intervals N for n steps - Simpson's rule needs an even number, so an odd n takes one more
+static inline unsigned long rule_intervals(int integrator, unsigned long n)
+{
+    return (integrator == 2) ? n + (n & 1) : n * rule_get(integrator)->refine;
+}
+
+// Weight of interior node i - 1 for Riemann and trapezoidal, alternating 4 and 2 for Simpson and RK4
+static inline double rule_weight(int integrator, unsigned long i)
+{
+    return (integrator == 2 || integrator == 3) ? 2.0 + 2.0*(double)(i & 1) : 1.0;
+}
+
+// Weighted sum of f over the interior nodes first..last-1 of the grid a + i*g
+double Rule_Interior(int integrator, double a, double g, unsigned long first, unsigned long last, double funct(double));
+
+// Integral of f over [a, b] in n steps on the calling thread
+double Rule_Integrate(int integrator, double a, double b, unsigned long n, double funct(double));
+
+// This thread's share of the integral of f over [a, b] in n steps, with the interior nodes split by schedule -
+// called by every thread of a team, with the results summed by a reduction
+double Local_Rule(int integrator, double a, double b, unsigned long n, double funct(double), partition_schedule_t schedule);
+
+#endif
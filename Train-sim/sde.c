@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+
+#include "sde.h"
+#include "philox.h"
+#include "trainode.h"
+
+// Stochastic train paths by Euler-Maruyama - see sde.h
+
+
+int sde_bands_alloc(sde_bands_t *b, int nbands)
+{
+    int k;
+
+    b->nbands = nbands;
+    b->time = calloc(nbands, sizeof(double));
+    b->vel = malloc(sizeof(welford_t) * nbands);
+    b->pos = malloc(sizeof(welford_t) * nbands);
+    b->vel_q = malloc(sizeof(qsketch_t) * nbands);
+    b->pos_q = malloc(sizeof(qsketch_t) * nbands);
+
+    if((b->time == NULL) || (b->vel == NULL) || (b->pos == NULL) || (b->vel_q == NULL) || (b->pos_q == NULL))
+    {
+        printf("Could not allocate statistics for %d bands\n", nbands);
+        sde_bands_free(b);
+        return -1;
+    }
+
+    for(k=0; k < nbands; k++)
+    {
+        welford_init(&b->vel[k]);
+        welford_init(&b->pos[k]);
+        qsketch_init(&b->vel_q[k]);
+        qsketch_init(&b->pos_q[k]);
+    }
+
+    return 0;
+}
+
+
+void sde_bands_free(sde_bands_t *b)
+{
+    free(b->time); free(b->vel); free(b->pos); free(b->vel_q); free(b->pos_q);
+    b->time = NULL; b->vel = b->pos = NULL; b->vel_q = b->pos_q = NULL;
+}
+
+
+void sde_bands_merge(sde_bands_t *b, const sde_bands_t *other)
+{
+    int k;
+
+    for(k=0; k < b->nbands; k++)
+    {
+        welford_merge(&b->vel[k], &other->vel[k]);
+        welford_merge(&b->pos[k], &other->pos[k]);
+        qsketch_merge(&b->vel_q[k], &other->vel_q[k]);
+        qsketch_merge(&b->pos_q[k], &other->pos_q[k]);
+    }
+}
+
+
+// A standard normal pair for each of the paths stream .. stream+n-1 from their Philox block - the generator loop
+// vectorizes, the log and sin/cos loop only where the vector math library is allowed
+static void block_normals(uint64_t seed, unsigned long stream, unsigned long block, int n, double *z1, double *z2)
+{
+    int i;
+
+    #pragma omp simd
+    for(i=0; i < n; i++)
+    {
+        uint64_t word0, word1;
+
+        philox_block(seed, stream + i, block, &word0, &word1);
+        z1[i] = philox_to_uniform(word0);
+        z2[i] = philox_to_uniform(word1);
+    }
+
+    for(i=0; i < n; i++)
+    {
+        double radius = sqrt(-2.0 * log(z1[i])), angle = PHILOX_TWO_PI * z2[i];
+
+        z1[i] = radius * cos(angle);
+        z2[i] = radius * sin(angle);
+    }
+}
+
+
+// Paths [first, first+n) of one block, small enough that the state stays in L1 across all the steps
+static void propagate_block(const sde_model_t *m, unsigned long first, int n, double h, unsigned long steps,
+                            const unsigned long *band_step, sde_bands_t *bands)
+{
+    double vel[SDE_BLOCK], pos[SDE_BLOCK], wind[SDE_BLOCK], eta[SDE_BLOCK], z1[SDE_BLOCK], z2[SDE_BLOCK];
+    double rolling = m->crr * TRAIN_GRAVITY, drag_per_mass = m->drag / m->mass;
+    double wind_decay = h / m->wind_tau, wind_kick = m->wind_sd * sqrt(2.0 * h / m->wind_tau);
+    double eta_decay = h / m->adhesion_tau, eta_kick = m->adhesion_sd * sqrt(2.0 * h / m->adhesion_tau);
+    unsigned long step;
+    int i, band = 0;
+
+    // the stationary distributions
+    block_normals(m->seed, first, 0, n, z1, z2);
+
+    #pragma omp simd
+    for(i=0; i < n; i++)
+    {
+        vel[i] = 0.0;
+        pos[i] = 0.0;
+        wind[i] = m->wind_sd * z1[i];
+        eta[i] = m->adhesion_sd * z2[i];
+    }
+
+    for(step=0; step < steps; step++)
+    {
+        double command = m->amplitude * sin((double)step * h / m->tscale);
+
+        block_normals(m->seed, first, step + 1, n, z1, z2);
+
+        #pragma omp simd
+        for(i=0; i < n; i++)
+        {
+            double v = vel[i], air = v + wind[i], f = 1.0 + eta[i], a;
+
+            f = (f < 0.0) ? 0.0 : ((f > 1.0) ? 1.0 : f);
+            a = f*command - rolling - drag_per_mass * air * fabs(air);
+
+            // brakes and resistance stop the train but never run it backward
+            vel[i] = (v + h*a > 0.0) ? v + h*a : 0.0;
+            pos[i] += h*v;
+
+            wind[i] += -wind_decay * wind[i] + wind_kick * z1[i];
+            eta[i] += -eta_decay * eta[i] + eta_kick * z2[i];
+        }
+
+        while((band < bands->nbands) && (step + 1 == band_step[band]))
+        {
+            for(i=0; i < n; i++)
+            {
+                welford_add(&bands->vel[band], vel[i]);
+                welford_add(&bands->pos[band], pos[i]);
+                qsketch_add(&bands->vel_q[band], vel[i]);
+                qsketch_add(&bands->pos_q[band], pos[i]);
+            }
+            band++;
+        }
+    }
+}
+
+
+int SDE_Propagate(const sde_model_t *m, unsigned long first, unsigned long npaths, double t1, unsigned long steps,
+                  sde_bands_t *bands, int thread_count)
+{
+    unsigned long nblocks = (npaths + SDE_BLOCK - 1) / SDE_BLOCK, *band_step;
+    sde_bands_t *thread_bands = malloc(sizeof(sde_bands_t) * thread_count);
+    double h = t1 / (double)steps;
+    int k, t;
+
+    band_step = malloc(sizeof(unsigned long) * bands->nbands);
+
+    if((thread_bands == NULL) || (band_step == NULL))
+    {
+        printf("Could not allocate the band statistics for %d threads\n", thread_count);
+        free(thread_bands); free(band_step);
+        return -1;
+    }
+
+    for(k=0; k < bands->nbands; k++)
+    {
+        band_step[k] = (unsigned long)((double)(k+1) * steps / bands->nbands + 0.5);
+        if(band_step[k] == 0) band_step[k] = 1;
+        bands->time[k] = band_step[k] * h;
+    }
+
+    // all of them, in case the team is smaller than asked for
+    for(t=0; t < thread_count; t++)
+        if(sde_bands_alloc(&thread_bands[t], bands->nbands) < 0)
+        {
+            while(t-- > 0) sde_bands_free(&thread_bands[t]);
+            free(thread_bands); free(band_step);
+            return -1;
+        }
+
+    #pragma omp parallel num_threads(thread_count)
+    {
+        sde_bands_t *mine = &thread_bands[omp_get_thread_num()];
+        unsigned long block;
+
+        #pragma omp for schedule(dynamic, 1)
+        for(block=0; block < nblocks; block++)
+        {
+            unsigned long start = block * SDE_BLOCK;
+            int n = (start + SDE_BLOCK < npaths) ? SDE_BLOCK : (int)(npaths - start);
+
+            propagate_block(m, first + start, n, h, steps, band_step, mine);
+        }
+    }
+
+    for(t=0; t < thread_count; t++)
+    {
+        sde_bands_merge(bands, &thread_bands[t]);
+        sde_bands_free(&thread_bands[t]);
+    }
+
+    free(thread_bands);
+    free(band_step);
+    return 0;
+}
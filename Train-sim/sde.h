@@ -0,0 +1,65 @@
+#ifndef SDE_H
+#define SDE_H
+
+#include <stdint.h>
+
+#include "montecarlo.h"
+
+// Stochastic train paths by Euler-Maruyama
+//
+// The other models are deterministic: the same train always follows the same path.  Here two noise processes
+// perturb the acceleration, each an Ornstein-Uhlenbeck process (mean reverting, with a stationary sd and a
+// correlation time tau):
+//
+//     wind        head wind gusts w in m/s, so the drag is on the air speed v + w (a tail wind when negative)
+//     adhesion    eta, the delivered fraction of the commanded traction or braking is 1 + eta, clamped to [0, 1]
+//                 since wheel slip loses effort but never adds it
+//
+//     dv = (f*amplitude*sin(t/tscale) - Crr*g - drag*(v+w)*|v+w|/mass) dt         f = min(1, max(0, 1 + eta))
+//     dx = v dt
+//     dw = -w/tau_w dt + sd_w*sqrt(2/tau_w) dW1
+//     deta = -eta/tau_a dt + sd_a*sqrt(2/tau_a) dW2
+//
+// starting at rest with w and eta drawn from their stationary distributions.  As in trainode.h the train never
+// runs backward, and at rest only starts once the command overcomes the resistance.  Euler-Maruyama needs the
+// step well below both correlation times.
+//
+// Paths are stored one array per state variable in blocks of SDE_BLOCK, so the loops over paths vectorize, with
+// the blocks split across threads.  Path i draws its noise from Philox stream i of the seed (block 0 for the
+// start, block k+1 for step k, see philox.h), so a path is the same whichever rank or thread runs it.
+//
+// No path is kept: at each of nbands times evenly spaced over the run every thread adds the velocity and position
+// of its paths to running moments and quantile sketches (see montecarlo.h), merged across the threads at the end
+// - memory is constant in the number of paths.
+//
+#define SDE_BLOCK (256)
+
+typedef struct
+{
+    double amplitude, tscale;               // profile, m/s^2 and s
+    double crr, mass, drag;                 // -, kg, N s^2/m^2
+    double wind_sd, wind_tau;               // m/s, s
+    double adhesion_sd, adhesion_tau;       // -, s
+    uint64_t seed;
+} sde_model_t;
+
+// Statistics of the paths at each band time
+typedef struct
+{
+    int nbands;
+    double *time;
+    welford_t *vel, *pos;
+    qsketch_t *vel_q, *pos_q;
+} sde_bands_t;
+
+// Empty statistics for nbands times, set by SDE_Propagate - returns 0, or -1 with a message printed
+int sde_bands_alloc(sde_bands_t *b, int nbands);
+void sde_bands_free(sde_bands_t *b);
+void sde_bands_merge(sde_bands_t *b, const sde_bands_t *other);
+
+// Propagate paths first .. first+npaths-1 from 0 to t1 in steps Euler-Maruyama steps, adding them to bands at the
+// steps nearest to t1*k/nbands for k = 1 .. nbands - returns 0, or -1 with a message printed
+int SDE_Propagate(const sde_model_t *m, unsigned long first, unsigned long npaths, double t1, unsigned long steps,
+                  sde_bands_t *bands, int thread_count);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef SIMOPTS_H
+#define SIMOPTS_H
+
+#include <string.h>
+
+// Command line helpers shared by the train simulators
+//
+// Named options are given as --name=value (or just --name for a flag) anywhere on the command line and
+// everything else is positional, so the original "[threads] [dt] ..." usage keeps working unchanged.
+
+
+// Copy argv[0] and the positional arguments into pos[] (which needs argc entries) and return how many there
+// are, so it can be used in place of argc
+static inline int sim_positional(int argc, char *argv[], char *pos[])
+{
+    int idx, count=0;
+
+    for(idx=0; idx < argc; idx++)
+    {
+        if((idx == 0) || (strncmp(argv[idx], "--", 2) != 0))
+            pos[count++] = argv[idx];
+    }
+
+    return count;
+}
+
+
+// Value of --name=value, "" for a bare --name, or NULL if the option was not given
+static inline const char *sim_option(int argc, char *argv[], const char *name)
+{
+    size_t len = strlen(name);
+    int idx;
+
+    for(idx=1; idx < argc; idx++)
+    {
+        if((strncmp(argv[idx], "--", 2) == 0) && (strncmp(argv[idx]+2, name, len) == 0))
+        {
+            if(argv[idx][2+len] == '=')
+                return &argv[idx][3+len];
+            else if(argv[idx][2+len] == '\0')
+                return "";
+        }
+    }
+
+    return NULL;
+}
+
+#endif
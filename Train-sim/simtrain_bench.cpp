@@ -0,0 +1,152 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <ctime>
+#include <omp.h>
+
+#include "integrators.hpp"
+
+extern "C" {
+#include "rules.h"
+}
+
+// Benchmark of the function pointer integrators against the template kernels in integrators.hpp
+//
+// The defaults are the cluster test configuration: the ex3 oracle over 1800 seconds with dt=5e-5, which is
+// 36M steps for each of the velocity and position integrals.  For each rule both paths integrate velocity
+// and position and the evaluations/second and results are printed side by side.
+//
+// The function pointer versions are the drivers' Local_* wrappers around Local_Rule from rules.c, with the default
+// static schedule - the same code the C drivers run, built at -O3 here as rules.o.  They are marked noipa so that
+// the optimizer cannot clone them for a known func and inline it - which it never can in the drivers, where the
+// integrand is chosen at run time.
+//
+//     ./simtrain_bench [threads] [dt] [duration]
+//
+
+#define Crr_MIN (0.0003)
+#define ACCEL_GRAVITY (9.81)
+
+double rolling_deceleration = Crr_MIN * ACCEL_GRAVITY;
+double tscale, ascale, vscale;
+
+double ex3_accel(double time)
+{
+    return (sin(time/tscale)*ascale);
+}
+
+double ex3_vel(double time)
+{
+    return ((-cos(time/tscale)+1)*vscale);
+}
+
+
+#define NOIPA __attribute__((noipa))
+
+partition_schedule_t schedule = {PARTITION_STATIC, 0};
+
+// integrator is the drivers' 0=Riemann, 1=Trap, 2=Simpson, 3=RK4
+NOIPA double Local_Riemann(double a, double b, unsigned long n, double funct(double))
+{
+    return Local_Rule(0, a, b, n, funct, schedule);
+}
+
+NOIPA double Local_Trap(double a, double b, unsigned long n, double funct(double))
+{
+    return Local_Rule(1, a, b, n, funct, schedule);
+}
+
+NOIPA double Local_Simpson(double a, double b, unsigned long n, double funct(double))
+{
+    return Local_Rule(2, a, b, n, funct, schedule);
+}
+
+NOIPA double Local_RK4(double a, double b, unsigned long n, double funct(double))
+{
+    return Local_Rule(3, a, b, n, funct, schedule);
+}
+
+
+double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+}
+
+
+typedef double (*local_integrator)(double, double, unsigned long, double (*)(double));
+
+// Velocity and position with one of the function pointer Local_* integrators
+void bench_pointer(const char *name, local_integrator local, int integrator,
+                   double duration, unsigned long n, int thread_count)
+{
+    double VelStep=0.0, PosStep=0.0, fstart, fend;
+
+    fstart = now();
+
+    #pragma omp parallel num_threads(thread_count) reduction(+:VelStep)
+    VelStep += local(0.0, duration, n, ex3_accel);
+
+    #pragma omp parallel num_threads(thread_count) reduction(+:PosStep)
+    PosStep += local(0.0, duration, n, ex3_vel);
+
+    fend = now();
+
+    printf("%-14s pointer  %8.4lf sec, %10.3le evals/sec, final velocity = %lf, final position = %lf\n",
+           name, fend-fstart, 2.0*(double)(rule_intervals(integrator, n) + 1) / (fend-fstart), VelStep, PosStep);
+}
+
+// Velocity and position with the template kernel for Rule
+template<class Rule>
+void bench_template(double duration, unsigned long n, int thread_count)
+{
+    trainsim::Ex3Accel<> accel = {tscale, ascale};
+    trainsim::Ex3Vel<> vel = {tscale, vscale};
+    double VelStep, PosStep, fstart, fend;
+
+    fstart = now();
+    VelStep = trainsim::integrate_omp<Rule>(accel, 0.0, duration, n, thread_count);
+    PosStep = trainsim::integrate_omp<Rule>(vel, 0.0, duration, n, thread_count);
+    fend = now();
+
+    printf("%-14s template %8.4lf sec, %10.3le evals/sec, final velocity = %lf, final position = %lf\n",
+           Rule::name, fend-fstart, 2.0*(double)trainsim::evaluations<Rule>(n) / (fend-fstart), VelStep, PosStep);
+}
+
+
+int main(int argc, char *argv[])
+{
+    int thread_count=1;
+    double dt=5.0e-5, duration=1800.0;
+    unsigned long n;
+
+    printf("\nUse: simtrain_bench [threads] [dt] [duration]\n");
+
+    if(argc >= 2) sscanf(argv[1], "%d", &thread_count);
+    if(argc >= 3) sscanf(argv[2], "%lf", &dt);
+    if(argc >= 4) sscanf(argv[3], "%lf", &duration);
+
+    n = (unsigned long)(duration / dt);
+
+    tscale=duration/(2.0*M_PI);
+    ascale=0.2365893166123-rolling_deceleration;
+    vscale=ascale*duration/(2.0*M_PI);
+
+    printf("Will benchmark with thread_count=%d, with dt=%le for %lu steps for %lf seconds\n\n", thread_count, dt, n, duration);
+
+    bench_pointer("Riemann", Local_Riemann, 0, duration, n, thread_count);
+    bench_template<trainsim::Riemann>(duration, n, thread_count);
+
+    bench_pointer("Trapezoidal", Local_Trap, 1, duration, n, thread_count);
+    bench_template<trainsim::Trapezoidal>(duration, n, thread_count);
+
+    bench_pointer("Simpson", Local_Simpson, 2, duration, n, thread_count);
+    bench_template<trainsim::Simpson>(duration, n, thread_count);
+
+    bench_pointer("Runge-Kutta-4", Local_RK4, 3, duration, n, thread_count);
+    bench_template<trainsim::RK4>(duration, n, thread_count);
+
+    return 0;
+}
@@ -1,9 +1,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <limits.h>
 #include <time.h>
 #include <omp.h>
 
+#include "profile.h"
+#include "simopts.h"
+#include "fused.h"
+#include "dopri5.h"
+#include "rules.h"
+#include "batch.h"
+#include "interp.h"
+
 // For values between 1 second indexed data, use linear interpolation to determine profile value at any "t".
 //
 // Wikipedia - https://en.wikipedia.org/wiki/Linear_interpolation
@@ -12,17 +21,32 @@
 // reasonably accurate for most non-linear functions over small intervals of 1 second.
 //
 // For high frequency non-linear functions spline and other more advanced curve fitting methods could be used, but
-// the piecewise linear assumption is sufficient for CSCI 551 for acceleration profiles given.
+// the piecewise linear assumption is sufficient for CSCI 551 for acceleration profiles given.  --interp=pchip or
+// --interp=spline selects a monotone cubic Hermite or natural cubic spline instead (see interp.h), so smooth
+// profiles can be sampled more sparsely for the same accuracy.
 //
 // The alternative to a look-up table with linear interpolation is direct modeling of a function, but this requires 
 // knowledge of the profile function as a linear, polynomial, or transcendental function or combination there-of, and
 // this may not be known.
 
+// The compiled-in DefaultProfile is used unless a binary profile is given with --profile=file (see profile.h)
+//
 #include "ex3.h"
 //#include "ex4.h"
 //#include "const.h"
 //#include "sine.h"
 
+// Acceleration table in use, either DefaultProfile or a column of a memory-mapped binary profile, with tsize
+// samples taken sample_period seconds apart (1 second for the spreadsheet profiles)
+//
+// A profile with a time column has samples at the times in SampleTime instead, which may be irregular or change
+// rate, and sample_period is then their mean spacing.  Each table interval is integrated in steps_per_idx steps
+// scaled by its length (see Interval_Steps), so every interval gets about dt without resampling the profile.
+const double *AccelProfile;
+int tsize;
+double sample_period=1.0;
+const double *SampleTime = (double *)0;
+
 
 // Coefficient of Rolling Resistance from https://youtu.be/-KAVJH_Dl80
 //
@@ -42,69 +66,242 @@
 double rolling_deceleration = 0.0;
 
 
-// table look-up for acceleration profile given and velocity profile determined
-double table_accel(int timeidx);
-double table_vel(int timeidx);
+// Interpolation tables of the acceleration profile given, with the --interp scheme, and of the velocity profile
+// determined (see interp.h) - AccelTable is built once, VelTable is refreshed by Vel_Update as VelProfile is filled.
+//
+// With linear interpolation VelTable is linear too, as the spreadsheet was.  With the cubic schemes the velocity
+// between samples is far from linear at the sample periods they allow, so VelTable is cubic Hermite with the
+// derivative at each sample taken from faccel, held in VelSlope.
+interp_table_t AccelTable, VelTable;
+double *VelSlope = (double *)0;
+void Vel_Update(int first, int last);
+
+// Integration steps for table interval idx
+int Interval_Steps(int idx, int steps_per_idx);
 
 // indirect generation of acceleration or velocity at any time with table interpolation
 double faccel(double time);
 double fvel(double time);
 
-// Create velocity and position profiles (tables) the same size as acceleration profile
-double VelProfile[sizeof(DefaultProfile) / sizeof(double)];
-double PosProfile[sizeof(DefaultProfile) / sizeof(double)];
+// the same for a profile with a time column, which search for the segment from that of the previous call on the
+// thread, so the sweeps of the integrators find the next one in O(1) (see interp_locate_from)
+double faccel_knots(double time);
+double fvel_knots(double time);
+int accel_hint = 0, vel_hint = 0;
+#pragma omp threadprivate(accel_hint, vel_hint)
+
+// the pair the integrators are given, chosen once for the profile so that evenly spaced samples pay no test per call
+double (*AccelFunc)(double) = faccel;
+double (*VelFunc)(double) = fvel;
+
+// the same for a block of up to BATCH_SIZE samples on a uniform grid, with --batch
+void faccel_batch(double t0, double dt, unsigned long n, double *out);
+void fvel_batch(double t0, double dt, unsigned long n, double *out);
+
+// Create velocity and position profiles (tables) the same size as acceleration profile, allocated in main
+double *VelProfile;
+double *PosProfile;
+
+// Implement methods of integration for OpenMP, with the steps split across threads by --schedule (see partition.h)
+// - the prefix-scan propagator calls Rule_Integrate (see rules.h) on whole table intervals instead
+partition_schedule_t schedule;
 
-// Implement methods of integration for OpenMP
 double Local_Riemann(double a, double b, int n, double func(double));
 double Local_Trap(double a, double b, int n, double func(double));
 double Local_Simpson(double a, double b, int n, double func(double));
 double Local_RK4(double a, double b, int n, double func(double));
 
-char *integrator_names[]={"Riemann", "Trapezoidal", "Simpson", "Runge-Kutta-4"};
+// Single parallel region alternative to the per-interval fork/join table loop
+//
+// Every propagator fills the table entries start+1..end from the values already in entry start, so a run can stop
+// at any index and be resumed from there (see --until, --save and --resume) - 0 and tsize-1 for a whole run
+void Scan_Propagate(int integrator, int start, int end, int steps_per_idx, int thread_count);
+void Fused_Scan_Propagate(int integrator, int start, int end, int steps_per_idx, int thread_count);
+void Scan_Block(double *table, int start, int first, int last, double *partial, int my_rank, int nthreads);
+
+// Closed form integration of the interpolated profile, as a propagator and as the --validate reference
+void Exact_Interval(int idx, double *dv, double *dx);
+void Exact_Propagate(double *vel, double *pos, int start, int end, int thread_count);
+
+// Saved state of a table run stopped at index - the table entry and the sample period it was computed with
+int State_Save(const char *file, int index, double vel, double pos);
+int State_Load(const char *file, int *index, double *vel, double *pos);
+
+char *integrator_names[]={"Riemann", "Trapezoidal", "Simpson", "Runge-Kutta-4", "Dormand-Prince-5(4)"};
 #define RIEMANN 0
 #define TRAPEZOIDAL 1
 #define SIMPSON 2
 #define RK4 3
+#define DOPRI5 4
+
+char *propagator_names[]={"per-interval", "prefix-scan", "fused-scan", "exact-linear"};
+#define PER_INTERVAL 0
+#define PREFIX_SCAN 1
+#define FUSED_SCAN 2
+#define EXACT_LINEAR 3
 
 
 void main(int argc, char *argv[])
 {
     int idx;
     double time, dt=0.1; // dt=0.1 takes 10 steps per step in spreadsheet
-    int tsize = (int)(sizeof(DefaultProfile) / sizeof(double));
-    unsigned long integration_steps=tsize;
-    int steps_per_idx=integration_steps/tsize;
-    int thread_count=1, integrator_selected=0;
+    unsigned long integration_steps;
+    int steps_per_idx, idx_steps;
+    int thread_count=1, integrator_selected=0, propagator_selected=PER_INTERVAL;
     double AccelStep, VelStep, PosStep;
     struct timespec start, end;
     double fstart, fend;
+    char *posv[argc+1];
+    int posc = sim_positional(argc, argv, posv);
+    const char *profile_file = sim_option(argc, argv, "profile");
+    profile_t profile;
+    double atol=1.0e-8, rtol=1.0e-10;
+    dopri_t dopri;
+    int start_idx=0, end_idx;
+    double until, resume_vel=0.0, resume_pos=0.0;
+    const char *save_file = sim_option(argc, argv, "save");
+    const char *resume_file = sim_option(argc, argv, "resume");
+    const char *arrive_option = sim_option(argc, argv, "arrive");
+    double arrive_pos=0.0, speed_limit=0.0, rest_speed=1.0e-3;
+    dopri_event_t events[3];
+    int hit=0;
+    int batch_selected = (sim_option(argc, argv, "batch") != NULL);
+    int interp_scheme;
+
+
+    printf("\nUse: simtrain [threads] [dt] [integrator is 0=Riemann, 1=Trap, 2=Simpsons, 3=RK4, 4=Dormand-Prince] [propagator is 0=per-interval, 1=prefix-scan, 2=fused-scan, 3=exact-linear]\n");
+    printf("     options: --profile=file.bin to load a binary profile, --noverify to skip its checksum\n");
+    printf("              --validate to compare the tables to the exact-linear solution and the velocity table's integral\n");
+    printf("              --schedule=static|dynamic|guided --chunk=size to split the steps across threads\n");
+    printf("              --atol=tolerance --rtol=tolerance for Dormand-Prince (default 1e-8 and 1e-10)\n");
+    printf("              --until=seconds to stop early, --save=file to save the final state, --resume=file to start from one\n");
+    printf("              --arrive=meters to stop Dormand-Prince at a position, --speed-limit=m/s to report overspeed\n");
+    printf("              --batch to interpolate the profile in SIMD blocks with the per-interval propagator\n");
+    printf("              --interp=linear|pchip|spline to interpolate the profile between samples (default linear)\n");
+
+    if(posc == 2)
+    {
+        sscanf(posv[1], "%d", &thread_count);
+    }
+    else if(posc == 3) 
+    {
+        sscanf(posv[1], "%d", &thread_count);
+        sscanf(posv[2], "%lf", &dt);
+    }
+    else if(posc == 4) 
+    {
+        sscanf(posv[1], "%d", &thread_count);
+        sscanf(posv[2], "%lf", &dt);
+        sscanf(posv[3], "%d", &integrator_selected);
+    }
+    else if(posc == 5) 
+    {
+        sscanf(posv[1], "%d", &thread_count);
+        sscanf(posv[2], "%lf", &dt);
+        sscanf(posv[3], "%d", &integrator_selected);
+        sscanf(posv[4], "%d", &propagator_selected);
+    }
 
+    if(sim_option(argc, argv, "atol")) sscanf(sim_option(argc, argv, "atol"), "%lf", &atol);
+    if(sim_option(argc, argv, "rtol")) sscanf(sim_option(argc, argv, "rtol"), "%lf", &rtol);
+    if(arrive_option != NULL) sscanf(arrive_option, "%lf", &arrive_pos);
+    if(sim_option(argc, argv, "speed-limit")) sscanf(sim_option(argc, argv, "speed-limit"), "%lf", &speed_limit);
 
-    printf("\nUse: simtrain [threads] [dt] [integrator is 0=Riemann, 1=Trap, 2=Simpsons, 3=RK4]\n");
+    if(partition_parse(sim_option(argc, argv, "schedule"), sim_option(argc, argv, "chunk"), &schedule) < 0)
+        exit(-1);
+
+    if(interp_parse(sim_option(argc, argv, "interp"), &interp_scheme) < 0)
+        exit(-1);
+
+    printf("\n***** Will simulate with %d threads, using dt=%lf, integrator=%s, propagator=%s, interpolation=%s\n",
+           thread_count, dt, integrator_names[integrator_selected], propagator_names[propagator_selected],
+           interp_names[interp_scheme]);
 
-    if(argc == 2)
+    if(profile_file != NULL)
     {
-        sscanf(argv[1], "%d", &thread_count);
+        if(profile_open(profile_file, &profile, sim_option(argc, argv, "noverify") == NULL) < 0)
+            exit(-1);
+
+        if((AccelProfile = profile_column(&profile, PROFILE_COL_ACCEL)) == NULL)
+        {
+            printf("Profile %s has no acceleration column\n", profile_file);
+            exit(-1);
+        }
+
+        // The tables index samples with an int
+        if(profile.header->count > (uint64_t)INT_MAX)
+        {
+            printf("Profile %s has %lu samples, at most %d are supported\n", profile_file,
+                   (unsigned long)profile.header->count, INT_MAX);
+            exit(-1);
+        }
+
+        tsize = (int)profile.header->count;
+        sample_period = 1.0 / profile.header->sample_rate;
+        SampleTime = profile_column(&profile, PROFILE_COL_TIME);
+
+        if(SampleTime != (double *)0)
+        {
+            AccelFunc = faccel_knots;
+            VelFunc = fvel_knots;
+        }
+
+        printf("\n***** Mapped profile %s with %d samples at %s%lf Hz\n", profile_file, tsize,
+               (SampleTime != (double *)0) ? "irregular times, a mean " : "", profile.header->sample_rate);
     }
-    else if(argc == 3) 
+    else
     {
-        sscanf(argv[1], "%d", &thread_count);
-        sscanf(argv[2], "%lf", &dt);
+        AccelProfile = DefaultProfile;
+        tsize = (int)(sizeof(DefaultProfile) / sizeof(double));
     }
-    else if(argc == 4) 
+
+    if(tsize < 2)
     {
-        sscanf(argv[1], "%d", &thread_count);
-        sscanf(argv[2], "%lf", &dt);
-        sscanf(argv[3], "%d", &integrator_selected);
+        printf("Profile needs at least 2 samples, has %d\n", tsize);
+        exit(-1);
     }
 
-    printf("\n***** Will simulate with %d threads, using dt=%lf, integrator=%s\n", thread_count, dt, integrator_names[integrator_selected]);
+    if(interp_build(&AccelTable, AccelProfile, tsize, sample_period, SampleTime, interp_scheme) < 0)
+        exit(-1);
 
-    integration_steps = (unsigned long) ((double)(tsize-1) / dt);
+    end_idx = tsize-1;
+
+    if(sim_option(argc, argv, "until"))
+    {
+        sscanf(sim_option(argc, argv, "until"), "%lf", &until);
+        if(until < interp_time(&AccelTable, end_idx))
+            end_idx = interp_locate(&AccelTable, until);
+    }
+
+    if(resume_file != NULL)
+    {
+        if(State_Load(resume_file, &start_idx, &resume_vel, &resume_pos) < 0)
+            exit(-1);
+
+        if(start_idx > end_idx)
+        {
+            printf("Saved state at table index %d is already past the end index %d\n", start_idx, end_idx);
+            exit(-1);
+        }
+
+        printf("\n***** Resuming from %s at table index %d, time=%lf, velocity=%lf, position=%lf\n",
+               resume_file, start_idx, interp_time(&AccelTable, start_idx), resume_vel, resume_pos);
+    }
+
+    VelProfile = malloc(sizeof(double) * tsize);
+    PosProfile = malloc(sizeof(double) * tsize);
+
+    if((VelProfile == (double *)0) || (PosProfile == (double *)0))
+    {
+        printf("Could not allocate velocity and position tables of %d samples\n", tsize);
+        exit(-1);
+    }
+
+    integration_steps = (unsigned long) ((double)(tsize-1) * sample_period / dt);
     steps_per_idx=integration_steps/(tsize-1);
 
-    printf("\n***** Will use default time profile with thread_count=%d, with dt=%lf for %lu steps and %d steps per table entry\n",
-           thread_count, dt, integration_steps, steps_per_idx);
+    printf("\n***** Will use %s time profile with thread_count=%d, with dt=%lf for %lu steps and %d steps per table entry\n",
+           (profile_file != NULL) ? "mapped" : "default", thread_count, dt, integration_steps, steps_per_idx);
 
     // Zero out VelProfile and PosProfile for next test
     for(idx=0; idx < tsize; idx++)
@@ -113,42 +310,149 @@ void main(int argc, char *argv[])
         PosProfile[idx]=0.0;
     }
 
+    if(interp_build(&VelTable, VelProfile, tsize, sample_period, SampleTime, INTERP_LINEAR) < 0)
+        exit(-1);
+
+    if(interp_scheme != INTERP_LINEAR)
+    {
+        if((VelSlope = malloc(sizeof(double) * tsize)) == (double *)0)
+        {
+            printf("Could not allocate velocity slopes of %d samples\n", tsize);
+            exit(-1);
+        }
+
+        for(idx=0; idx < tsize; idx++)
+            VelSlope[idx] = AccelFunc(interp_time(&AccelTable, idx));
+    }
+
     // Integration to match spreadsheet with Look-up & interpolate integration function
     //
     // Potential to speed up with OpenMP or Pthreads
     //
     printf("\nTHREADED INTEGRATOR: integration with table with %d elements\n", tsize);
     clock_gettime(CLOCK_MONOTONIC, &start);
-    VelStep=0.0; VelProfile[0]=VelStep;
-    PosStep=0.0; PosProfile[0]=PosStep;
+    VelStep=resume_vel; VelProfile[start_idx]=VelStep;
+    PosStep=resume_pos; PosProfile[start_idx]=PosStep;
     double time_a, time_b;
 
+    // Dormand-Prince picks its own steps, but the interpolated profile has a kink at every sample, so each step
+    // ends on the next sample time and never straddles one - within a sample interval the acceleration is linear
+    // and a single step is usually exact, while the error control still covers any non-linear faccel
+    if(integrator_selected == DOPRI5)
+    {
+        double (*accel_ptr)(double) = AccelFunc;
+        double y0[2] = {resume_vel, resume_pos};
+
+        dopri_init(&dopri, 2, train_rhs, &accel_ptr, interp_time(&AccelTable, start_idx), y0, atol, rtol);
+
+        // Arrival at --arrive is terminal, overspeed and coming to rest are only reported - the arrival event
+        // is only armed with --arrive, so without it the table is filled to the end
+        events[0] = (dopri_event_t){ .g = train_position_event, .ctx = &arrive_pos, .direction = DOPRI_EVENT_RISING,
+                                     .terminal = (arrive_option != NULL) };
+        events[1] = (dopri_event_t){ .g = train_velocity_event, .ctx = &speed_limit, .direction = DOPRI_EVENT_RISING };
+        events[2] = (dopri_event_t){ .g = train_velocity_event, .ctx = &rest_speed, .direction = DOPRI_EVENT_FALLING };
+        dopri_events_init(&dopri, events, 3);
+
+        for(idx=start_idx; idx < end_idx; idx++)
+        {
+            dopri.hmax = interp_width(&AccelTable, idx);
+
+            if((hit = dopri_events(&dopri, interp_time(&AccelTable, idx+1), events, 3)) < 0)
+                exit(-1);
+
+            // stopped within this interval, so the table ends at the last whole sample before the arrival
+            if(hit > 0)
+            {
+                end_idx = idx;
+                break;
+            }
+
+            VelProfile[idx+1]=dopri.y[0];
+            PosProfile[idx+1]=dopri.y[1];
+        }
+
+        printf("Dormand-Prince: %lu steps, %lu rejected, %lu evaluations, error estimate vel=%le pos=%le\n",
+               dopri.steps, dopri.rejected, dopri.evaluations, dopri.err_sum[0], dopri.err_sum[1]);
+
+        if((speed_limit > 0.0) && (events[1].count > 0))
+            printf("Speed limit %lf m/s first exceeded at time %lf, position %lf, %lu times in all\n",
+                   speed_limit, events[1].t, events[1].y[1], events[1].count);
+
+        if(events[2].count > 0)
+            printf("Train comes to rest at time %lf, position %lf\n", events[2].t, events[2].y[1]);
+
+        if(hit > 0)
+            printf("Arrival at %lf m at time %.9lf with velocity %lf\n", arrive_pos, events[0].t, events[0].y[0]);
+        else if(arrive_option != NULL)
+            printf("Train does not reach %lf m by the end of the table\n", arrive_pos);
+    }
+
+    // The per-interval loop below opens two parallel regions per table entry, so for small steps_per_idx the
+    // fork/join overhead dominates - the prefix-scan propagator does the whole table in one parallel region
+    else if(propagator_selected == PREFIX_SCAN)
+    {
+        Scan_Propagate(integrator_selected, start_idx, end_idx, steps_per_idx, thread_count);
+        idx=end_idx;
+    }
+    else if(propagator_selected == FUSED_SCAN)
+    {
+        Fused_Scan_Propagate(integrator_selected, start_idx, end_idx, steps_per_idx, thread_count);
+        idx=end_idx;
+    }
+
+    // No steps at all - the integrator and dt are not used
+    else if(propagator_selected == EXACT_LINEAR)
+    {
+        Exact_Propagate(VelProfile, PosProfile, start_idx, end_idx, thread_count);
+        idx=end_idx;
+    }
+
+    // The batch path runs the same rules on blocks of interpolated samples, a vectorized loop per block
+    else if(batch_selected) for(idx=start_idx; idx < end_idx; idx++)
+    {
+        time_a = interp_time(&AccelTable, idx);
+        time_b = interp_time(&AccelTable, idx+1);
+        idx_steps = Interval_Steps(idx, steps_per_idx);
+
+        #pragma omp parallel num_threads(thread_count) reduction(+:VelStep)
+        VelStep += Local_Batch(integrator_selected, time_a, time_b, idx_steps, faccel_batch, schedule);
+        VelProfile[idx+1]=VelStep;
+        Vel_Update(idx, idx+2);
+
+        #pragma omp parallel num_threads(thread_count) reduction(+:PosStep)
+        PosStep += Local_Batch(integrator_selected, time_a, time_b, idx_steps, fvel_batch, schedule);
+        PosProfile[idx+1]=PosStep;
+    }
+
     // Overall simulation table loop for time=0, to last time in model
-    for(idx=0; idx < tsize-1; idx++)
+    else for(idx=start_idx; idx < end_idx; idx++)
     {
-        time_a = (double)idx;
-        time_b = (double)idx+1;
+        time_a = interp_time(&AccelTable, idx);
+        time_b = interp_time(&AccelTable, idx+1);
+        idx_steps = Interval_Steps(idx, steps_per_idx);
 
         switch(integrator_selected)
         {
             case RIEMANN:
                 #pragma omp parallel num_threads(thread_count) reduction(+:VelStep)
-                VelStep += Local_Riemann(time_a, time_b, steps_per_idx, faccel);
+                VelStep += Local_Riemann(time_a, time_b, idx_steps, AccelFunc);
                 VelProfile[idx+1]=VelStep;
-                
+                Vel_Update(idx, idx+2);
+
                 #pragma omp parallel num_threads(thread_count) reduction(+:PosStep)
-                PosStep += Local_Riemann(time_a, time_b, steps_per_idx, fvel);
+                PosStep += Local_Riemann(time_a, time_b, idx_steps, VelFunc);
                 PosProfile[idx+1]=PosStep;
 
                 break;
 
             case TRAPEZOIDAL:
                 #pragma omp parallel num_threads(thread_count) reduction(+:VelStep)
-                VelStep += Local_Trap(time_a, time_b, steps_per_idx, faccel);
+                VelStep += Local_Trap(time_a, time_b, idx_steps, AccelFunc);
                 VelProfile[idx+1]=VelStep;
-                
+                Vel_Update(idx, idx+2);
+
                 #pragma omp parallel num_threads(thread_count) reduction(+:PosStep)
-                PosStep += Local_Trap(time_a, time_b, steps_per_idx, fvel);
+                PosStep += Local_Trap(time_a, time_b, idx_steps, VelFunc);
                 PosProfile[idx+1]=PosStep;
 
                 break;
@@ -156,33 +460,36 @@ void main(int argc, char *argv[])
 
             case SIMPSON:
                 #pragma omp parallel num_threads(thread_count) reduction(+:VelStep)
-                VelStep += Local_Simpson(time_a, time_b, steps_per_idx, faccel);
+                VelStep += Local_Simpson(time_a, time_b, idx_steps, AccelFunc);
                 VelProfile[idx+1]=VelStep;
-                
+                Vel_Update(idx, idx+2);
+
                 #pragma omp parallel num_threads(thread_count) reduction(+:PosStep)
-                PosStep += Local_Simpson(time_a, time_b, steps_per_idx, fvel);
+                PosStep += Local_Simpson(time_a, time_b, idx_steps, VelFunc);
                 PosProfile[idx+1]=PosStep;
 
                 break;
 
             case RK4:
                 #pragma omp parallel num_threads(thread_count) reduction(+:VelStep)
-                VelStep += Local_RK4(time_a, time_b, steps_per_idx, faccel);
+                VelStep += Local_RK4(time_a, time_b, idx_steps, AccelFunc);
                 VelProfile[idx+1]=VelStep;
-                
+                Vel_Update(idx, idx+2);
+
                 #pragma omp parallel num_threads(thread_count) reduction(+:PosStep)
-                PosStep += Local_RK4(time_a, time_b, steps_per_idx, fvel);
+                PosStep += Local_RK4(time_a, time_b, idx_steps, VelFunc);
                 PosProfile[idx+1]=PosStep;
 
                 break;
 
             default:
                 #pragma omp parallel num_threads(thread_count) reduction(+:VelStep)
-                VelStep += Local_Riemann(time_a, time_b, steps_per_idx, faccel);
+                VelStep += Local_Riemann(time_a, time_b, idx_steps, AccelFunc);
                 VelProfile[idx+1]=VelStep;
+                Vel_Update(idx, idx+2);
 
                 #pragma omp parallel num_threads(thread_count) reduction(+:PosStep)
-                PosStep += Local_Riemann(time_a, time_b, steps_per_idx, fvel);
+                PosStep += Local_Riemann(time_a, time_b, idx_steps, VelFunc);
                 PosProfile[idx+1]=PosStep;
 
                 break;
@@ -195,239 +502,449 @@ void main(int argc, char *argv[])
 
     printf("final table index = %d for table of size %d\n", idx, tsize);
     printf("Train from table in %lf seconds with %d samples: final velocity = %lf, final position = %lf\n", 
-	       (fend-fstart), tsize, VelProfile[tsize-1], PosProfile[tsize-1]);
+	       (fend-fstart), end_idx-start_idx+1, VelProfile[end_idx], PosProfile[end_idx]);
 
-}
+    if(save_file != NULL)
+    {
+        if(State_Save(save_file, end_idx, VelProfile[end_idx], PosProfile[end_idx]) < 0)
+            exit(-1);
 
+        printf("Saved state at table index %d, time=%lf to %s\n", end_idx, interp_time(&AccelTable, end_idx), save_file);
+    }
 
-double Local_Riemann(double a, double b, int n, double funct(double))
-{
-    double dt, interval_sum=0.0, local_a, local_b, time;
-    int my_rank = omp_get_thread_num();
-    int thread_count = omp_get_num_threads();
+    // Compare every table entry to the exact solution for the same interpolated profile - a resumed run is compared
+    // from its own starting entry.  The velocity difference is the integrator's own error.  Positions from fvel
+    // (per-interval and prefix-scan) integrate the velocity table, interpolated between the velocity samples, which
+    // misses the exact position by its interpolation error whatever dt.  So positions are compared with the
+    // integral of the same interpolant of the exact velocities too, and that interpolation error is printed on its
+    // own - fused-scan, exact-linear and Dormand-Prince integrate the velocity itself and match the exact position.
+    if(sim_option(argc, argv, "validate") != NULL)
+    {
+        double *ExactVel = calloc(tsize, sizeof(double));
+        double *ExactPos = malloc(sizeof(double) * tsize);
+        double *TablePos = malloc(sizeof(double) * tsize);
+        double vel_err=0.0, pos_err=0.0, table_err=0.0, interp_err=0.0;
+        interp_table_t ExactVelTable;
 
-    dt = (b-a)/((double)n);
+        if((ExactVel == (double *)0) || (ExactPos == (double *)0) || (TablePos == (double *)0))
+        {
+            printf("Could not allocate exact velocity and position tables of %d samples\n", tsize);
+            exit(-1);
+        }
 
-    int idx, local_n;
+        ExactVel[start_idx] = resume_vel;
+        ExactPos[start_idx] = resume_pos;
+        Exact_Propagate(ExactVel, ExactPos, start_idx, end_idx, thread_count);
 
-    local_n = n / thread_count;
+        // the velocity table fvel would interpolate from the exact velocities
+        if(interp_build(&ExactVelTable, ExactVel, tsize, sample_period, SampleTime, INTERP_LINEAR) < 0)
+            exit(-1);
 
-    local_a = a + my_rank*local_n*dt;
-    local_b = local_a + local_n*dt;
+        if(VelSlope != (double *)0)
+            interp_update_hermite(&ExactVelTable, ExactVel, VelSlope, start_idx, end_idx+1);
 
+        TablePos[start_idx] = resume_pos;
+        for(idx=start_idx; idx < end_idx; idx++)
+            TablePos[idx+1] = TablePos[idx] + interp_width(&AccelTable, idx) * interp_segment_integral(&ExactVelTable, idx, 1.0);
 
-    for(idx=1; idx <= local_n; idx++)
-    {
-        time = local_a + idx*dt;
-        interval_sum += (funct(time) * dt);
-        //printf("Step for my_rank=%d at time=%lf, f(t)=%lf, sum=%lf\n", my_rank, time, funct(time), interval_sum);
+        for(idx=start_idx; idx <= end_idx; idx++)
+        {
+            if(fabs(VelProfile[idx] - ExactVel[idx]) > vel_err) vel_err = fabs(VelProfile[idx] - ExactVel[idx]);
+            if(fabs(PosProfile[idx] - ExactPos[idx]) > pos_err) pos_err = fabs(PosProfile[idx] - ExactPos[idx]);
+            if(fabs(PosProfile[idx] - TablePos[idx]) > table_err) table_err = fabs(PosProfile[idx] - TablePos[idx]);
+            if(fabs(TablePos[idx] - ExactPos[idx]) > interp_err) interp_err = fabs(TablePos[idx] - ExactPos[idx]);
+        }
+
+        printf("Exact-linear reference: final velocity = %lf, final position = %lf, max error velocity = %le, position = %le\n",
+               ExactVel[end_idx], ExactPos[end_idx], vel_err, pos_err);
+        printf("Velocity table reference: max error position = %le, with the table's interpolation error = %le apart from exact\n",
+               table_err, interp_err);
+
+        interp_free(&ExactVelTable);
+        free(ExactVel);
+        free(ExactPos);
+        free(TablePos);
     }
 
-    //printf("Local Riemann = %lf for my_rank=%d of threads %d with dt=%lf, on a=%lf to b=%lf for %d steps\n",
-    //        interval_sum, my_rank, thread_count, dt, local_a, local_b, local_n);
+    free(VelProfile);
+    free(PosProfile);
+    interp_free(&AccelTable);
+    interp_free(&VelTable);
+    free(VelSlope);
+
+    if(profile_file != NULL)
+        profile_close(&profile);
+}
+
 
-    return interval_sum;
+double Local_Riemann(double a, double b, int n, double funct(double))
+{
+    return Local_Rule(RIEMANN, a, b, n, funct, schedule);
 }
 
 
 double Local_Trap(double a, double b, int n, double funct(double))
 {
-    double dt = (b - a) / n;
-    double local_a, local_b, time, interval_sum;
-    int my_rank = omp_get_thread_num();
-    int thread_count = omp_get_num_threads();
-    int idx, local_n;
+    return Local_Rule(TRAPEZOIDAL, a, b, n, funct, schedule);
+}
+
+
+double Local_Simpson(double a, double b, int n, double funct(double))
+{
+    return Local_Rule(SIMPSON, a, b, n, funct, schedule);
+}
+
 
-    local_n = n / thread_count;
+double Local_RK4(double a, double b, int n, double funct(double))
+{
+    return Local_Rule(RK4, a, b, n, funct, schedule);
+}
 
-    local_a = a + my_rank*local_n*dt;
-    local_b = local_a + local_n*dt;
 
-    interval_sum = (funct(local_a) + funct(local_b)) / 2.0;
+// Prefix-scan propagator
+//
+// The table intervals are independent for velocity: VelProfile[idx+1]-VelProfile[idx] is just the integral of
+// faccel over [idx, idx+1].  So each thread integrates a contiguous block of intervals sequentially, storing
+// the increments in place, and then a parallel prefix scan turns the increments into the running sum.
+//
+// Position works the same way, except that fvel interpolates VelProfile, so it can only start once the velocity
+// scan is complete.  All of this happens inside one parallel region with barriers rather than 2*(tsize-1)
+// separate fork/joins.
+//
+void Scan_Propagate(int integrator, int start, int end, int steps_per_idx, int thread_count)
+{
+    double *partial = malloc(sizeof(double) * (thread_count+1));
+
+    if(partial == (double *)0)
+    {
+        printf("Scan_Propagate: could not allocate %d partial sums\n", thread_count+1);
+        exit(-1);
+    }
 
-    for (idx = 1; idx < local_n; idx++)
+    #pragma omp parallel num_threads(thread_count)
     {
-        time = local_a + idx * dt;
-        interval_sum += funct(time);
+        int my_rank = omp_get_thread_num();
+        int nthreads = omp_get_num_threads();
+        unsigned long block_first, block_last;
+        int first, last, idx;
+
+        // Contiguous block [first, last) of table intervals for this thread, in thread order for the scans
+        partition_static_range(start, end, my_rank, nthreads, &block_first, &block_last);
+        first = (int)block_first;
+        last = (int)block_last;
+
+        for(idx=first; idx < last; idx++)
+            VelProfile[idx+1] = Rule_Integrate(integrator, interp_time(&AccelTable, idx), interp_time(&AccelTable, idx+1),
+                                                 Interval_Steps(idx, steps_per_idx), AccelFunc);
+
+        Scan_Block(VelProfile, start, first, last, partial, my_rank, nthreads);
+
+        // Scan_Block ends with a barrier, so all of VelProfile is now valid - each thread refreshes the slopes of
+        // its own block, the last one the final sample too, and fvel can be used once they all have
+        Vel_Update(first, (last == end) ? end+1 : last);
+        #pragma omp barrier
+
+        for(idx=first; idx < last; idx++)
+            PosProfile[idx+1] = Rule_Integrate(integrator, interp_time(&AccelTable, idx), interp_time(&AccelTable, idx+1),
+                                                 Interval_Steps(idx, steps_per_idx), VelFunc);
+
+        Scan_Block(PosProfile, start, first, last, partial, my_rank, nthreads);
     }
 
-    return dt * interval_sum;
+    free(partial);
 }
 
 
-double Local_Simpson(double a, double b, int n, double funct(double))
+// Fused prefix-scan propagator
+//
+// Same single parallel region as Scan_Propagate, but each table interval is swept once with Fused_Sweep, which
+// only evaluates faccel and gives both the velocity change and the position change from rest.  After the
+// velocity scan, the position increment of interval idx is that change from rest plus VelProfile[idx] times the
+// interval length, and a second scan of those fills PosProfile - so fvel is never evaluated at all.
+//
+void Fused_Scan_Propagate(int integrator, int start, int end, int steps_per_idx, int thread_count)
 {
-    double dt = (b - a) / n;
-    double interval_sum = 0.0;
-    double local_a, local_b, time, fx;
-    int my_rank = omp_get_thread_num();
-    int thread_count = omp_get_num_threads();
-    int idx, local_n;
-
-    local_n = n / thread_count;
-
-    local_a = a + my_rank*local_n*dt;
-    local_b = local_a + local_n*dt;
-
-    for (idx = 1; idx <= local_n; idx++)
-    {
-        time = local_a + idx * dt;
-        fx = funct(time);
-
-        // See https://en.wikipedia.org/wiki/Simpson's_rule for more information
-        //
-        // 1) on the first we evaluate f(a) and on the last we evaluate f(b)
-        // 2) for steps between we alternate between (4/3)f(a+b) and (2/3)f(a+b)
-        // 3) at the end we return h times the weighted sum of all the 1/3, 4/3, 2/3 summation
-        //    terms.
-        //
-        if (idx == 0 || idx == local_n)
-        {
-            interval_sum += fx;
-        }
+    double *partial = malloc(sizeof(double) * (thread_count+1));
 
-        // Alternating 4/3 and 2/3 weighting for points between f(a) and f(b)
-        else if (idx % 2 == 1)
-        {
-            interval_sum += 4.0 * fx;
-        }
-        else
-        {
-            interval_sum += 2.0 * fx;
-        }
+    if(partial == (double *)0)
+    {
+        printf("Fused_Scan_Propagate: could not allocate %d partial sums\n", thread_count+1);
+        exit(-1);
     }
 
-    // h=(b-a)/n, sum= [f(a) + f(b)] + (4 or 2)*f(a+b), all multipied by 1/3
-    return dt * interval_sum / 3.0;
+    #pragma omp parallel num_threads(thread_count)
+    {
+        int my_rank = omp_get_thread_num();
+        int nthreads = omp_get_num_threads();
+        unsigned long block_first, block_last;
+        int first, last, idx;
+
+        partition_static_range(start, end, my_rank, nthreads, &block_first, &block_last);
+        first = (int)block_first;
+        last = (int)block_last;
+
+        for(idx=first; idx < last; idx++)
+            Fused_Sweep(integrator, interp_time(&AccelTable, idx), interp_time(&AccelTable, idx+1),
+                        Interval_Steps(idx, steps_per_idx), AccelFunc,
+                        &VelProfile[idx+1], &PosProfile[idx+1]);
+
+        Scan_Block(VelProfile, start, first, last, partial, my_rank, nthreads);
+
+        for(idx=first; idx < last; idx++)
+            PosProfile[idx+1] += VelProfile[idx] * interp_width(&AccelTable, idx);
+
+        Scan_Block(PosProfile, start, first, last, partial, my_rank, nthreads);
+    }
+
+    free(partial);
 }
 
 
-double Local_RK4(double a, double b, int n, double funct(double))
+// Exact-linear propagator
+//
+// faccel is a polynomial of at most third degree between samples (see interp.h), shifted by the rolling
+// deceleration in the direction of its sign.  Each interval is split at the zeros of its polynomial p, so on each
+// piece from fraction u0 to u1 of the interval the shift c = +/-rolling_deceleration is constant, and with P and Q
+// the first and second integrals of p from 0 and L the length of the interval, Lp = L*(u1 - u0), the velocity and position
+// changes of the piece starting from rest are exactly
+//
+//     dv = L*(P(u1) - P(u0)) + c*Lp
+//     dx = L*L*(Q(u1) - Q(u0) - P(u0)*(u1 - u0)) + c*Lp*Lp/2
+//
+// which for linear interpolation from a0 to a1 over a whole interval are L*(a0 + a1)/2 + c*L and
+// L*L*(2*a0 + a1)/6 + c*L*L/2.  The pieces are combined the same way the fused chunks are, dx = dx1 + dx2 + dv1*L2,
+// and the intervals then stitched together with the same two prefix scans as Fused_Scan_Propagate, so the whole
+// table is O(tsize) with no dt error.
+//
+void Exact_Interval(int idx, double *dv, double *dx)
 {
-    double dt = (b - a) / n;
-    double interval_sum = 0.0;
-    double local_a, local_b, time, k1, k2, k3, k4;
-    int my_rank = omp_get_thread_num();
-    int thread_count = omp_get_num_threads();
-    int idx, local_n;
+    double roots[3], edge[5], L = interp_width(&AccelTable, idx), u0, u1, Lp, P0, c, mid;
+    int nedge = 0, nroots = interp_segment_roots(&AccelTable, idx, roots), k;
 
-    local_n = n / thread_count;
+    edge[nedge++] = 0.0;
+    for(k=0; k < nroots; k++)
+        edge[nedge++] = roots[k];
+    edge[nedge++] = 1.0;
 
-    local_a = a + my_rank*local_n*dt;
-    local_b = local_a + local_n*dt;
+    *dv = 0.0;
+    *dx = 0.0;
 
+    for(k=0; k < nedge-1; k++)
+    {
+        u0 = edge[k];
+        u1 = edge[k+1];
+        Lp = L * (u1 - u0);
+        P0 = interp_segment_integral(&AccelTable, idx, u0);
+
+        // one sign throughout the piece, or zero throughout when coasting
+        mid = interp_segment_value(&AccelTable, idx, 0.5*(u0 + u1));
+        c = interp_signed_bias(mid, rolling_deceleration) - mid;
+
+        *dx += L*L*(interp_segment_integral2(&AccelTable, idx, u1) - interp_segment_integral2(&AccelTable, idx, u0)
+                    - P0*(u1 - u0)) + c*Lp*Lp/2.0 + (*dv)*Lp;
+        *dv += L*(interp_segment_integral(&AccelTable, idx, u1) - P0) + c*Lp;
+    }
+}
+
+
+void Exact_Propagate(double *vel, double *pos, int start, int end, int thread_count)
+{
+    double *partial = malloc(sizeof(double) * (thread_count+1));
+
+    if(partial == (double *)0)
+    {
+        printf("Exact_Propagate: could not allocate %d partial sums\n", thread_count+1);
+        exit(-1);
+    }
 
-    // March from a to b in n uniform steps
-    for (idx = 1; idx <= local_n; idx++)
+    #pragma omp parallel num_threads(thread_count)
     {
-        time = local_a + idx * dt;
+        int my_rank = omp_get_thread_num();
+        int nthreads = omp_get_num_threads();
+        unsigned long block_first, block_last;
+        int first, last, idx;
+
+        partition_static_range(start, end, my_rank, nthreads, &block_first, &block_last);
+        first = (int)block_first;
+        last = (int)block_last;
+
+        for(idx=first; idx < last; idx++)
+            Exact_Interval(idx, &vel[idx+1], &pos[idx+1]);
+
+        Scan_Block(vel, start, first, last, partial, my_rank, nthreads);
+
+        for(idx=first; idx < last; idx++)
+            pos[idx+1] += vel[idx] * interp_width(&AccelTable, idx);
 
-        // RK4 stages: k1..k4 evaluate f at time, time+dt/2, time+dt
-        k1 = funct(time);
-        k2 = funct(time + 0.5 * dt);
-        k3 = funct(time + 0.5 * dt);
-        k4 = funct(time + dt);
+        Scan_Block(pos, start, first, last, partial, my_rank, nthreads);
+    }
+
+    free(partial);
+}
+
+
+// Called by every thread in the team: table[first+1..last] hold increments for this thread's intervals, and on
+// return table[start+1..end] hold the inclusive running sum starting from table[start]
+//
+void Scan_Block(double *table, int start, int first, int last, double *partial, int my_rank, int nthreads)
+{
+    double offset;
+    int idx;
 
-        // Update the integral using RK4 combination
-        interval_sum += k1 + 2.0*k2 + 2.0*k3 + k4;
+    // 1) local inclusive scan of this thread's block
+    for(idx=first+1; idx < last; idx++)
+        table[idx+1] += table[idx];
+
+    partial[my_rank+1] = (last > first) ? table[last] : 0.0;
+
+    #pragma omp barrier
+
+    // 2) exclusive scan of the block totals, seeded with the initial table value
+    #pragma omp single
+    {
+        partial[0] = table[start];
+        for(idx=1; idx <= nthreads; idx++)
+            partial[idx] += partial[idx-1];
     }
 
-    return dt * interval_sum / 6.0;
+    // 3) shift this block by the sum of everything before it
+    offset = partial[my_rank];
+    for(idx=first; idx < last; idx++)
+        table[idx+1] += offset;
+
+    #pragma omp barrier
 }
 
 
-// Simple look-up in accleration profile array
+// Saved state of a table run - one line of text with the table index, the sample period, and the velocity and
+// position at that index, written with full precision so a resumed run continues from exactly the same values
 //
-// Added array bounds check for known size of train arrays
+// Only the table entry is needed to resume: the propagators restart each interval from its own samples, and
+// Dormand-Prince re-derives its first stage and step size from the state.
 //
-double table_accel(int timeidx)
+int State_Save(const char *file, int index, double vel, double pos)
 {
-    long unsigned int tsize = sizeof(DefaultProfile) / sizeof(double);
+    FILE *fp = fopen(file, "w");
 
-    // Check array bounds for look-up table
-    if(timeidx > tsize)
+    if(fp == NULL)
     {
-        printf("timeidx=%d exceeds table size = %lu and range %d to %lu\n", timeidx, tsize, 0, tsize-1);
-        exit(-1);
+        printf("Could not create state file %s\n", file);
+        return -1;
     }
 
-    return DefaultProfile[timeidx];
+    fprintf(fp, "%d %.17le %.17le %.17le\n", index, sample_period, vel, pos);
+    fclose(fp);
+
+    return 0;
 }
 
 
-double table_vel(int timeidx)
+int State_Load(const char *file, int *index, double *vel, double *pos)
 {
-    long unsigned int tsize = sizeof(VelProfile) / sizeof(double);
+    FILE *fp = fopen(file, "r");
+    double period;
+    int fields;
 
-    if(timeidx > tsize)
+    if(fp == NULL)
     {
-        printf("timeidx=%d exceeds table size = %lu and range %d to %lu\n", timeidx, tsize, 0, tsize-1);
-        exit(-1);
+        printf("Could not open state file %s\n", file);
+        return -1;
+    }
+
+    fields = fscanf(fp, "%d %le %le %le", index, &period, vel, pos);
+    fclose(fp);
+
+    if(fields != 4)
+    {
+        printf("State file %s should hold index, sample period, velocity and position\n", file);
+        return -1;
+    }
+
+    if((*index < 0) || (*index >= tsize) || (fabs(period - sample_period) > 1.0e-12 * sample_period))
+    {
+        printf("State file %s at index %d with period %lf does not fit the profile of %d samples at period %lf\n",
+               file, *index, period, tsize, sample_period);
+        return -1;
     }
 
-    return VelProfile[timeidx];
+    return 0;
 }
 
 
-// Simple linear interpolation example for table_accel(t) for any floating point t value
-// for a table of accelerations that are 1 second apart in time, evenly spaced in time.
+// Interpolation for faccel(t) at any floating point t value, for a table of accelerations sampled
+// sample_period seconds apart, from the precomputed coefficients in AccelTable (see interp.h).  Linearly,
 //
 // accel[timeidx] <= accel[time] < accel[timeidx_next]
 //
+//     accel[time] = accel[timeidx] + (accel[timeidx_next] - accel[timeidx]) * delta_t
+//
+// with delta_t the fraction of a sample period since timeidx, and a cubic in delta_t for the other schemes.  Time past the last sample holds the last value,
+// since the RK4 stage at time+dt and the interpolation at the final sample both look just beyond the table.
+//
+// If train is speeding up, assume motor adds acceleration to overcome rolling deceleration, and if train is
+// braking, assume brakes are applied as needed over and above rolling deceleration - a coasting train gets
+// none, with the sign taken without a branch.
 //
 double faccel(double time)
 {
-    // The timeidx is an index into the known acceleration profile at a time <= time of interest passed in
-    //
-    // Note that conversion to integer truncates double to next lowest integer value or floor(time)
-    //
-    int timeidx = (int)time;
+    return interp_signed_bias(interp_at_uniform(&AccelTable, time), rolling_deceleration);
+}
 
-    // The timeidx_next is an index into the known acceleration profile at a time > time of interest passed in
-    //
-    // Note that the conversion to integer truncates double and the +1 is added for ceiling(time)
-    //
-    int timeidx_next = ((int)time)+1;
 
-    // delta_t = time of interest - time at known value < time
-    //
-    // For more general case
-    // double delta_t = (time - (double)((int)time)) / ((double)(timeidx_next - timeidx);
-    //
-    // If time in table is always 1 second apart, then we can simplify since (timeidx_next - timeidx) = 1.0 by definition here
-    double delta_t = time - (double)((int)time);
+double fvel(double time)
+{
+    return interp_at_uniform(&VelTable, time);
+}
 
-    // The accel[time] is a linear value between accel[timeidx] and accel[timeidx_next]
-    // 
-    // The accel[time] is a value that can be determined by the slope of the interval and accel[timedix] 
-    //
-    // I.e. accel[time] = accel[timeidx] + ( (accel[timeidx_next] - accel[timeidx]) / ((double)(timeidx_next - timeidx)) ) * delta_t
-    //
-    //      ((double)(timeidx_next - timeidx)) = 1.0
-    // 
-    //      accel[time] = accel[timeidx] + (accel[timeidx_next] - accel[timeidx]) * delta_t
-    //
-    double accel_input = table_accel(timeidx) + ( (table_accel(timeidx_next) - table_accel(timeidx)) * delta_t);
 
-    // if train is speeding up, assume motor adds acceleration to overcome rolling deceleration
-    if(accel_input > 0.0)
-        return(accel_input + rolling_deceleration);
+double faccel_knots(double time)
+{
+    int idx = interp_locate_from(&AccelTable, time, &accel_hint);
+
+    return interp_signed_bias(interp_at_segment(&AccelTable, idx, time), rolling_deceleration);
+}
 
-    // if train is braking, assume brakes are applied as needed over and above rolling deceleration
-    else if(accel_input < 0.0)
-        return(accel_input - rolling_deceleration);
 
-    // if the train is coasting, then just return what should be no acceleration
-    else
-        return(accel_input);
+double fvel_knots(double time)
+{
+    int idx = interp_locate_from(&VelTable, time, &vel_hint);
+
+    return interp_at_segment(&VelTable, idx, time);
 }
 
 
-double fvel(double time)
+// n must be at most BATCH_SIZE, as it is from Local_Batch
+void faccel_batch(double t0, double dt, unsigned long n, double *out)
 {
-    int timeidx = (int)time;
-    int timeidx_next = ((int)time)+1;
-    double delta_t = time - (double)((int)time);
+    interp_grid(&AccelTable, t0, dt, n, rolling_deceleration, out);
+}
+
+
+void fvel_batch(double t0, double dt, unsigned long n, double *out)
+{
+    interp_grid(&VelTable, t0, dt, n, 0.0, out);
+}
+
+
+// Steps for table interval idx - steps_per_idx for evenly spaced samples, and in proportion to the length of the
+// interval otherwise, at least one
+int Interval_Steps(int idx, int steps_per_idx)
+{
+    int steps;
+
+    if(SampleTime == (double *)0)
+        return steps_per_idx;
+
+    steps = (int)(interp_width(&AccelTable, idx) / sample_period * (double)steps_per_idx + 0.5);
+    return (steps > 0) ? steps : 1;
+}
 
-    return (table_vel(timeidx) + ( (table_vel(timeidx_next) - table_vel(timeidx)) * delta_t) );
+
+// Refresh VelTable entries first..last-1 from VelProfile
+void Vel_Update(int first, int last)
+{
+    if(VelSlope != (double *)0)
+        interp_update_hermite(&VelTable, VelProfile, VelSlope, first, last);
+    else
+        interp_update(&VelTable, VelProfile, first, last);
 }
@@ -0,0 +1,203 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <ctime>
+#include <omp.h>
+
+#include "integrators.hpp"
+#include "dual.hpp"
+#include "simopts.h"
+
+// Sensitivities and Newton solves for the ex3 train by forward-mode automatic differentiation
+//
+// simtrainideal searches for the duration reaching the target by sweeping durations across the ranks, and any
+// other tuning means rerunning with finite differences.  Here the integrators.hpp kernels run on dual numbers
+// (dual.hpp), so one run gives the final velocity and position and their exact derivatives with respect to
+//
+//     scale       multiplies the ex3 amplitude, 1.0 as simtrainideal
+//     Crr         rolling resistance, ascale = scale*EX3_AMPLITUDE - Crr*g as simtrainideal
+//     duration    with the profile stretched over it, tscale = duration/(2*pi) as simtrainideal
+//
+// which are checked against central finite differences, and then used for Newton solves of the duration, and of
+// the scale for the given duration, that reach the target position - a handful of runs on one node.
+//
+//     ./simtrain_tune [threads] [dt] [duration] [integrator is 0=Riemann, 1=Trap, 2=Simpsons, 3=RK4]
+//                     [--target=meters] [--crr=value] [--scale=value] [--tol=meters]
+//
+
+#define Crr_MIN (0.0003)
+#define ACCEL_GRAVITY (9.81)
+#define EX3_AMPLITUDE (0.2365893166123)
+
+#define NEWTON_MAX_ITERATIONS (20)
+
+using trainsim::Dual;
+using trainsim::value;
+using trainsim::derivative;
+
+int thread_count=4;
+double dt=0.01;
+int integrator_selected=3;
+
+
+double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+}
+
+
+// Final velocity and position from rest with Rule, for double or dual parameters
+template<class Rule, class T>
+void final_state_rule(T scale, T crr, T duration, unsigned long n, T *vel, T *pos)
+{
+    T tscale = duration / (2.0*M_PI);
+    T ascale = scale*EX3_AMPLITUDE - crr*ACCEL_GRAVITY;
+    trainsim::Ex3Accel<T> accel = {tscale, ascale};
+    trainsim::Ex3Vel<T> velocity = {tscale, ascale*tscale};
+
+    *vel = trainsim::integrate_omp<Rule>(accel, T(0.0), duration, n, thread_count);
+    *pos = trainsim::integrate_omp<Rule>(velocity, T(0.0), duration, n, thread_count);
+}
+
+// The same with the selected integrator, in steps of dt
+template<class T>
+void final_state(T scale, T crr, T duration, T *vel, T *pos)
+{
+    unsigned long n = (unsigned long)(value(duration) / dt + 1.0e-6);
+
+    switch(integrator_selected)
+    {
+        case 0: final_state_rule<trainsim::Riemann>(scale, crr, duration, n, vel, pos); break;
+        case 1: final_state_rule<trainsim::Trapezoidal>(scale, crr, duration, n, vel, pos); break;
+        case 2: final_state_rule<trainsim::Simpson>(scale, crr, duration, n, vel, pos); break;
+        default: final_state_rule<trainsim::RK4>(scale, crr, duration, n, vel, pos); break;
+    }
+}
+
+
+// Central difference of the final position with respect to parameter k of p, relative step 1e-6
+double position_difference(const double p[3], int k)
+{
+    double lo[3] = {p[0], p[1], p[2]}, hi[3] = {p[0], p[1], p[2]}, h = 1.0e-6 * std::fabs(p[k]), vel, pos_lo, pos_hi;
+
+    lo[k] -= h;
+    hi[k] += h;
+    final_state(lo[0], lo[1], lo[2], &vel, &pos_lo);
+    final_state(hi[0], hi[1], hi[2], &vel, &pos_hi);
+
+    return (pos_hi - pos_lo) / (2.0*h);
+}
+
+
+int main(int argc, char *argv[])
+{
+    const char *names[3] = {"scale", "Crr", "duration"};
+    const char *rules[4] = {"Riemann", "Trapezoidal", "Simpson", "Runge-Kutta-4"};
+    double duration=1800.0, target=122000.0, crr=Crr_MIN, scale=1.0, tol=1.0e-3;
+    double p[3], fd[3], vel, pos, fstart, fend, dual_time, fd_time;
+    char *posv[argc+1];
+    int posc = sim_positional(argc, argv, posv), k, iter;
+
+    printf("\nUse: simtrain_tune [threads] [dt] [duration] [integrator is 0=Riemann, 1=Trap, 2=Simpsons, 3=RK4]\n");
+    printf("     options: --target=meters (default 122000), --crr=value (default 0.0003), --scale=value (default 1)\n");
+    printf("              --tol=meters for the Newton solves (default 1e-3)\n");
+
+    if(posc >= 2) sscanf(posv[1], "%d", &thread_count);
+    if(posc >= 3) sscanf(posv[2], "%lf", &dt);
+    if(posc >= 4) sscanf(posv[3], "%lf", &duration);
+    if(posc >= 5) sscanf(posv[4], "%d", &integrator_selected);
+
+    if(sim_option(argc, argv, "target")) sscanf(sim_option(argc, argv, "target"), "%lf", &target);
+    if(sim_option(argc, argv, "crr")) sscanf(sim_option(argc, argv, "crr"), "%lf", &crr);
+    if(sim_option(argc, argv, "scale")) sscanf(sim_option(argc, argv, "scale"), "%lf", &scale);
+    if(sim_option(argc, argv, "tol")) sscanf(sim_option(argc, argv, "tol"), "%lf", &tol);
+
+    if((integrator_selected < 0) || (integrator_selected > 3))
+    {
+        printf("Integrator %d is not one of the template rules 0 to 3\n", integrator_selected);
+        exit(-1);
+    }
+
+    printf("Will differentiate %s with thread_count=%d, dt=%le for %lf seconds, scale=%lf, Crr=%lf\n\n",
+           rules[integrator_selected], thread_count, dt, duration, scale, crr);
+
+    // all three sensitivities in one run
+    {
+        Dual<3> dvel, dpos;
+
+        fstart = now();
+        final_state(Dual<3>::variable(scale, 0), Dual<3>::variable(crr, 1), Dual<3>::variable(duration, 2), &dvel, &dpos);
+        fend = now();
+        dual_time = fend - fstart;
+
+        printf("Dual run in %lf seconds: final velocity = %lf, final position = %lf\n", dual_time, value(dvel), value(dpos));
+
+        p[0] = scale; p[1] = crr; p[2] = duration;
+
+        fstart = now();
+        final_state(scale, crr, duration, &vel, &pos);
+        for(k=0; k < 3; k++)
+            fd[k] = position_difference(p, k);
+        fend = now();
+        fd_time = fend - fstart;
+
+        for(k=0; k < 3; k++)
+            printf("    d position / d %-8s = %18.9le, central difference %18.9le, relative difference %le\n",
+                   names[k], derivative(dpos, k), fd[k], std::fabs(derivative(dpos, k) - fd[k]) / std::fabs(fd[k]));
+
+        printf("Finite differences take 7 runs in %lf seconds, %lf times the dual run\n\n", fd_time, fd_time / dual_time);
+    }
+
+    // Newton on the duration
+    {
+        double d = duration;
+        Dual<1> dvel, dpos;
+
+        fstart = now();
+        for(iter=1; iter <= NEWTON_MAX_ITERATIONS; iter++)
+        {
+            final_state(Dual<1>(scale), Dual<1>(crr), Dual<1>::variable(d, 0), &dvel, &dpos);
+
+            printf("    duration iteration %d: duration = %.9lf, position = %lf, error = %le m\n",
+                   iter, d, value(dpos), value(dpos) - target);
+
+            if(std::fabs(value(dpos) - target) <= tol) break;
+            d -= (value(dpos) - target) / derivative(dpos, 0);
+        }
+        fend = now();
+
+        if(iter > NEWTON_MAX_ITERATIONS)
+            printf("Duration solve did not reach %le m in %d iterations\n\n", tol, NEWTON_MAX_ITERATIONS);
+        else
+            printf("Duration reaching %lf m is %.9lf seconds, %d runs in %lf seconds\n\n", target, d, iter, fend - fstart);
+    }
+
+    // Newton on the scale for the given duration
+    {
+        double s = scale;
+        Dual<1> dvel, dpos;
+
+        fstart = now();
+        for(iter=1; iter <= NEWTON_MAX_ITERATIONS; iter++)
+        {
+            final_state(Dual<1>::variable(s, 0), Dual<1>(crr), Dual<1>(duration), &dvel, &dpos);
+
+            printf("    scale iteration %d: scale = %.12lf, position = %lf, error = %le m\n",
+                   iter, s, value(dpos), value(dpos) - target);
+
+            if(std::fabs(value(dpos) - target) <= tol) break;
+            s -= (value(dpos) - target) / derivative(dpos, 0);
+        }
+        fend = now();
+
+        if(iter > NEWTON_MAX_ITERATIONS)
+            printf("Scale solve did not reach %le m in %d iterations\n", tol, NEWTON_MAX_ITERATIONS);
+        else
+            printf("Scale reaching %lf m in %lf seconds is %.12lf, %d runs in %lf seconds\n", target, duration, s, iter, fend - fstart);
+    }
+
+    return 0;
+}
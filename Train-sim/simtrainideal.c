@@ -1,11 +1,24 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <time.h>
 #include <omp.h>
 
 #include <mpi.h>
 
+#include "batch.h"
+#include "fused.h"
+#include "dopri5.h"
+#include "quadrature.h"
+#include "parareal.h"
+#include "trainode.h"
+#include "ensemble.h"
+#include "montecarlo.h"
+#include "sde.h"
+#include "rules.h"
+#include "simopts.h"
+
 // Coefficient of Rolling Resistance from https://youtu.be/-KAVJH_Dl80
 //
 // Force_rolling_resist = m*accel
@@ -26,35 +39,149 @@ double rolling_deceleration = Crr_MIN * ACCEL_GRAVITY;
 double duration=1800.0;
 double tscale, ascale, vscale; //computed in main based on actual duration
 
+// peak acceleration of the ex3 profile, before the rolling resistance is taken off for ascale
+#define EX3_AMPLITUDE (0.2365893166123)
+
 // direct generation of acceleration at any time with math library and arithmetic
 double ex3_accel(double time);
 double ex3_vel(double time);
 
-// Implement methods of integration for OpenMP
+// the ex3 profile at EX3_AMPLITUDE, for the models that apply their own resistance
+double ex3_raw_accel(double time);
+
+// the same oracles for a block of up to BATCH_SIZE samples on a uniform grid, with --batch
+void ex3_accel_batch(double t0, double dt, unsigned long n, double *out);
+void ex3_vel_batch(double t0, double dt, unsigned long n, double *out);
+
+// Implement methods of integration for OpenMP, with the steps split across threads by --schedule (see partition.h)
+partition_schedule_t schedule;
+
 double Local_Riemann(double a, double b, unsigned long n, double func(double));
 double Local_Trap(double a, double b, unsigned long n, double func(double));
 double Local_Simpson(double a, double b, unsigned long n, double func(double));
 double Local_RK4(double a, double b, unsigned long n, double func(double));
 
-char *integrator_names[]={"Riemann", "Trapezoidal", "Simpson", "Runge-Kutta-4"};
+char *integrator_names[]={"Riemann", "Trapezoidal", "Simpson", "Runge-Kutta-4", "Dormand-Prince-5(4)", "Romberg", "Gauss-Legendre"};
 #define RIEMANN 0
 #define TRAPEZOIDAL 1
 #define SIMPSON 2
 #define RK4 3
+#define DOPRI5 4
+#define ROMBERG 5
+#define GAUSS_LEGENDRE 6
+
+// Run configuration from the command line, shared by every simulation this run makes
+double dt=1.0; // dt=1.0 is the default to match spreadsheet
+int integrator_selected=0;
+int thread_count=4;
+int batch_selected=0, fused_selected=0;
+double dopri_atol=1.0e-8, dopri_rtol=1.0e-10;   // Dormand-Prince
+double romberg_tol=1.0e-6;                      // Romberg
+int gauss_order=8;                              // Gauss-Legendre
+unsigned long gauss_panels=16;
+
+// With --tscale the ex3 profile keeps a fixed period rather than being stretched over each duration simulated, so
+// every simulation follows the same profile and one past the end of rank 0's trial carries on from the trial's end
+// state instead of starting over (see fused.h)
+double fixed_tscale=0.0;
+fused_state_t *resume_state=NULL;
+
+// Continue state from state->time to t_end with the selected integrator, with method statistics if verbose
+void Simulate_Extend(fused_state_t *state, double t_end, int my_rank, int verbose);
+
+// Final velocity and position for a run of sim_duration from rest, resuming from resume_state where possible
+void Simulate_Duration(double sim_duration, int my_rank, int verbose, double *vel, double *pos);
+
+// One run of sim_duration from rest split across the ranks by time, see below - every rank gets the final state
+void Distributed_Duration(double sim_duration, int my_rank, int comm_sz, double *vel, double *pos);
+
+// With --parareal the train follows the state-dependent model (see trainode.h) driven by ex3_accel: Davis
+// resistance set with --davis=A,B,C - only the aerodynamic C*v^2 term by default, since ascale already takes off
+// the rolling resistance - plus grade and curve resistance with --track=file.csv, and tractive energy with --energy
+train_model_t model;
+track_t track;
+
+// Parareal solve of one run of sim_duration from rest with the model, fine solves split across the ranks and
+// their threads, compared to sequential RK4 with the same steps on rank 0
+void Parareal_Duration(double sim_duration, int slices, unsigned long coarse_steps, double tol, int my_rank, int comm_sz);
+
+// With --ensemble=N every rank propagates N trains at once (see ensemble.h), each with its own Crr, mass and
+// profile scale spread over the ranges below, against aerodynamic drag of --drag N s^2/m^2
+#define MASS_MIN (300000.0)
+#define MASS_MAX (600000.0)
+#define SCALE_MIN (0.95)
+#define SCALE_MAX (1.05)
+void Ensemble_Duration(double sim_duration, int ntrains, double drag, double TargetPos, int my_rank, int comm_sz);
+
+// With --montecarlo=N, N trains in all with Crr, mass and profile scale drawn from --crr-dist, --mass-dist and
+// --scale-dist (see montecarlo.h), each run with Dormand-Prince to its arrival at TargetPos (up to MC_HORIZON
+// durations) against rolling resistance and --drag, reducing the arrival times and the positions at the end of
+// the duration to moments and quantiles
+#define MC_HORIZON (4.0)
+typedef struct
+{
+    dist_t crr, mass, scale;
+    double drag;
+    uint64_t seed;
+} mc_config_t;
+
+void Monte_Carlo(unsigned long samples, const mc_config_t *config, double sim_duration, double TargetPos, int my_rank, int comm_sz);
+
+// With --sde=N, N stochastic paths in all of one train (Crr midway, --mass or MID_MASS, --drag) with wind gust and
+// adhesion noise (see sde.h) by Euler-Maruyama at dt, reducing the velocity and position at --bands times over the
+// duration to moments and percentile bands
+#define MID_MASS (450000.0)
+void Stochastic_Duration(unsigned long paths, const sde_model_t *config, int nbands, double sim_duration, int my_rank, int comm_sz);
+
+// Parallel search for the duration whose final position is TargetPos, see below
+double Duration_Search(double TargetPos, double d0, double pos0, double estTime, double postol, int my_rank, int comm_sz,
+                       int *rounds, unsigned long *sims);
+#define SEARCH_MAX_ROUNDS (60)
+
+// Time the train reaches target_pos, found in one Dormand-Prince run from rest by event location (see dopri5.h),
+// also reporting when it first exceeds speed_limit (if > 0) and comes back to rest - returns -1.0 if the target is
+// not reached by t_max
+double Simulate_Arrival(double target_pos, double speed_limit, double t_max);
+
+// Speed below which the train counts as at rest for the arrival events, m/s
+#define REST_SPEED (1.0e-3)
 
 // mpiexec -n 4 ./simtrainideal 4 0.001 1800 0
 
 void main(int argc, char *argv[])
 {
     int idx;
-    double time, dt=1.0; // dt=1.0 is the default to match spreadsheet
+    double time;
     unsigned long integration_steps;
-    int integrator_selected=0;
-    int thread_count=4;
     double AccelStep, VelStep, PosStep;
     struct timespec start, end;
     double fstart, fend;
     double TargetPos=122000.0;
+    char *posv[argc+1];
+    int posc = sim_positional(argc, argv, posv);
+    const char *search_option = sim_option(argc, argv, "search");
+    const char *arrive_option = sim_option(argc, argv, "arrive");
+    int distribute_selected = (sim_option(argc, argv, "distribute") != NULL);
+    const char *parareal_option = sim_option(argc, argv, "parareal");
+    int parareal_slices;
+    unsigned long coarse_steps=1;
+    double parareal_tol=1.0e-6;
+    const char *ensemble_option = sim_option(argc, argv, "ensemble");
+    int ensemble_trains=10000;
+    double ensemble_drag=4.0;
+    const char *mc_option = sim_option(argc, argv, "montecarlo");
+    unsigned long mc_samples=100000;
+    mc_config_t mc_config = { .crr = {DIST_UNIFORM, Crr_MIN, Crr_MAX}, .mass = {DIST_UNIFORM, MASS_MIN, MASS_MAX},
+                              .scale = {DIST_NORMAL, 1.0, 0.02}, .seed = 551 };
+    const char *sde_option = sim_option(argc, argv, "sde");
+    unsigned long sde_paths=10000;
+    int sde_bands=10;
+    sde_model_t sde_config = { .crr = 0.5*(Crr_MIN + Crr_MAX), .mass = MID_MASS, .wind_sd = 3.0, .wind_tau = 60.0,
+                               .adhesion_sd = 0.05, .adhesion_tau = 120.0 };
+    double speed_limit=0.0;
+    double search_tol=1.0e-3;
+    int search_rounds;
+    unsigned long search_sims;
     double targetErr=0.0;
     double leastErr=0.0;
 
@@ -69,48 +196,223 @@ void main(int argc, char *argv[])
     double distLeft=0.0;
     double estTime = 0.0;
     double time_a, time_b;
+    fused_state_t trial_state;
 
     MPI_Init(NULL, NULL);
     MPI_Comm_size(MPI_COMM_WORLD, &comm_sz);
     MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
 
-    if(my_rank == 0) printf("\nUse: simtrain [threads] [dt] [duration] [integrator is 0=Riemann, 1=Trap, 2=Simpsons, 3=RK4]\n");
-
-    if(argc == 2)
+    if(my_rank == 0) printf("\nUse: simtrain [threads] [dt] [duration] [integrator is 0=Riemann, 1=Trap, 2=Simpsons, 3=RK4, 4=Dormand-Prince, 5=Romberg, 6=Gauss-Legendre]\n");
+    if(my_rank == 0) printf("     options: --batch to evaluate the oracle in SIMD blocks, --fused for one velocity+position sweep\n");
+    if(my_rank == 0) printf("              --atol=tolerance --rtol=tolerance for Dormand-Prince (default 1e-8 and 1e-10)\n");
+    if(my_rank == 0) printf("              --tol=tolerance for Romberg (default 1e-6)\n");
+    if(my_rank == 0) printf("              --order=nodes --panels=count for Gauss-Legendre (default 8 and 16)\n");
+    if(my_rank == 0) printf("              --schedule=static|dynamic|guided --chunk=size to split the steps across threads\n");
+    if(my_rank == 0) printf("              --search[=meters] to search for the duration reaching the target across ranks (default 1e-3)\n");
+    if(my_rank == 0) printf("              --tscale=seconds to fix the profile period, so longer runs resume from the trial run\n");
+    if(my_rank == 0) printf("              --arrive[=meters] to find the arrival time at the target in one run, --speed-limit=m/s to report overspeed\n");
+    if(my_rank == 0) printf("              --distribute to split one run of the duration across the ranks instead of sweeping durations\n");
+    if(my_rank == 0) printf("              --parareal[=slices] for a parallel-in-time RK4 run with Davis resistance --davis=A,B,C,\n");
+    if(my_rank == 0) printf("                  --coarse=steps per slice (default 1) and --ptol=tolerance (default 1e-6)\n");
+    if(my_rank == 0) printf("                  --track=file.csv of grade,radius lines --spacing=meters apart (default 100),\n");
+    if(my_rank == 0) printf("                  --curve-coeff=meters (default 0.65), --energy --mass=kg for the tractive energy\n");
+    if(my_rank == 0) printf("              --ensemble[=trains] to propagate that many trains per rank in one pass (default 10000),\n");
+    if(my_rank == 0) printf("                  with --drag=N s^2/m^2 aerodynamic drag (default 4)\n");
+    if(my_rank == 0) printf("              --montecarlo[=samples] for arrival statistics over --crr-dist, --mass-dist and --scale-dist,\n");
+    if(my_rank == 0) printf("                  each fixed:x, uniform:lo:hi, normal:mean:sd or lognormal:mu:sigma, with --seed=n (default 551)\n");
+    if(my_rank == 0) printf("              --sde[=paths] for Euler-Maruyama paths (default 10000) with --wind=sd,tau gusts (default 3,60)\n");
+    if(my_rank == 0) printf("                  and --adhesion=sd,tau variation (default 0.05,120), percentile bands at --bands times (default 10)\n");
+
+    if(posc == 2)
+    {
+        sscanf(posv[1], "%d", &thread_count);
+    }
+    else if(posc == 3) 
     {
-        sscanf(argv[1], "%d", &thread_count);
+        sscanf(posv[1], "%d", &thread_count);
+        sscanf(posv[2], "%lf", &dt);
     }
-    else if(argc == 3) 
+    else if(posc == 4) 
     {
-        sscanf(argv[1], "%d", &thread_count);
-        sscanf(argv[2], "%lf", &dt);
+        sscanf(posv[1], "%d", &thread_count);
+        sscanf(posv[2], "%lf", &dt);
+        sscanf(posv[3], "%lf", &duration);
     }
-    else if(argc == 4) 
+    else if(posc == 5) 
     {
-        sscanf(argv[1], "%d", &thread_count);
-        sscanf(argv[2], "%lf", &dt);
-        sscanf(argv[3], "%lf", &duration);
+        sscanf(posv[1], "%d", &thread_count);
+        sscanf(posv[2], "%lf", &dt);
+        sscanf(posv[3], "%lf", &duration);
+        sscanf(posv[4], "%d", &integrator_selected);
     }
-    else if(argc == 5) 
+
+    batch_selected = (sim_option(argc, argv, "batch") != NULL);
+    fused_selected = (sim_option(argc, argv, "fused") != NULL);
+
+    if(sim_option(argc, argv, "atol")) sscanf(sim_option(argc, argv, "atol"), "%lf", &dopri_atol);
+    if(sim_option(argc, argv, "rtol")) sscanf(sim_option(argc, argv, "rtol"), "%lf", &dopri_rtol);
+    if(sim_option(argc, argv, "tol")) sscanf(sim_option(argc, argv, "tol"), "%lf", &romberg_tol);
+    if(sim_option(argc, argv, "order")) sscanf(sim_option(argc, argv, "order"), "%d", &gauss_order);
+    if(sim_option(argc, argv, "panels")) sscanf(sim_option(argc, argv, "panels"), "%lu", &gauss_panels);
+    if(sim_option(argc, argv, "tscale")) sscanf(sim_option(argc, argv, "tscale"), "%lf", &fixed_tscale);
+
+    if(partition_parse(sim_option(argc, argv, "schedule"), sim_option(argc, argv, "chunk"), &schedule) < 0)
+        exit(-1);
+
+    if((search_option != NULL) && (*search_option != '\0'))
+        sscanf(search_option, "%lf", &search_tol);
+
+    if((arrive_option != NULL) && (*arrive_option != '\0'))
+        sscanf(arrive_option, "%lf", &TargetPos);
+
+    if(sim_option(argc, argv, "speed-limit")) sscanf(sim_option(argc, argv, "speed-limit"), "%lf", &speed_limit);
+
+    train_model_init(&model, ex3_accel);
+    model.davis_c = 2.0e-6;
+    model.curve_coeff = 0.65;
+    model.energy = (sim_option(argc, argv, "energy") != NULL);
+    track.spacing = 100.0;
+
+    if(sim_option(argc, argv, "davis")) sscanf(sim_option(argc, argv, "davis"), "%lf,%lf,%lf", &model.davis_a, &model.davis_b, &model.davis_c);
+    if(sim_option(argc, argv, "curve-coeff")) sscanf(sim_option(argc, argv, "curve-coeff"), "%lf", &model.curve_coeff);
+    if(sim_option(argc, argv, "mass")) sscanf(sim_option(argc, argv, "mass"), "%lf", &model.mass);
+    if(sim_option(argc, argv, "spacing")) sscanf(sim_option(argc, argv, "spacing"), "%lf", &track.spacing);
+
+    train_model_add(&model, train_force_davis);
+
+    if(sim_option(argc, argv, "track"))
     {
-        sscanf(argv[1], "%d", &thread_count);
-        sscanf(argv[2], "%lf", &dt);
-        sscanf(argv[3], "%lf", &duration);
-        sscanf(argv[4], "%d", &integrator_selected);
+        if(track_load(sim_option(argc, argv, "track"), track.spacing, &track) < 0)
+            exit(-1);
+
+        model.track = &track;
+        train_model_add(&model, train_force_grade);
+        train_model_add(&model, train_force_curve);
     }
+    if(sim_option(argc, argv, "coarse")) sscanf(sim_option(argc, argv, "coarse"), "%lu", &coarse_steps);
+    if(sim_option(argc, argv, "ptol")) sscanf(sim_option(argc, argv, "ptol"), "%lf", &parareal_tol);
+
+    if((ensemble_option != NULL) && (*ensemble_option != '\0'))
+        sscanf(ensemble_option, "%d", &ensemble_trains);
+    if(sim_option(argc, argv, "drag")) sscanf(sim_option(argc, argv, "drag"), "%lf", &ensemble_drag);
+
+    if((mc_option != NULL) && (*mc_option != '\0'))
+        sscanf(mc_option, "%lu", &mc_samples);
+    if(sim_option(argc, argv, "crr-dist") && (dist_parse(sim_option(argc, argv, "crr-dist"), &mc_config.crr) < 0))
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    if(sim_option(argc, argv, "mass-dist") && (dist_parse(sim_option(argc, argv, "mass-dist"), &mc_config.mass) < 0))
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    if(sim_option(argc, argv, "scale-dist") && (dist_parse(sim_option(argc, argv, "scale-dist"), &mc_config.scale) < 0))
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    if(sim_option(argc, argv, "seed")) sscanf(sim_option(argc, argv, "seed"), "%lu", &mc_config.seed);
+    mc_config.drag = ensemble_drag;
+
+    if((sde_option != NULL) && (*sde_option != '\0'))
+        sscanf(sde_option, "%lu", &sde_paths);
+    if(sim_option(argc, argv, "wind")) sscanf(sim_option(argc, argv, "wind"), "%lf,%lf", &sde_config.wind_sd, &sde_config.wind_tau);
+    if(sim_option(argc, argv, "adhesion")) sscanf(sim_option(argc, argv, "adhesion"), "%lf,%lf", &sde_config.adhesion_sd, &sde_config.adhesion_tau);
+    if(sim_option(argc, argv, "bands")) sscanf(sim_option(argc, argv, "bands"), "%d", &sde_bands);
+    if(sim_option(argc, argv, "mass")) sscanf(sim_option(argc, argv, "mass"), "%lf", &sde_config.mass);
+    sde_config.drag = ensemble_drag;
+    sde_config.seed = mc_config.seed;
+
+    // one slice per thread of every rank unless given
+    parareal_slices = comm_sz * thread_count;
+    if((parareal_option != NULL) && (*parareal_option != '\0'))
+        sscanf(parareal_option, "%d", &parareal_slices);
 
     integration_steps = duration / dt;
 
-    // determined such that the sine curve is stretched over duration
+    // determined such that the sine curve is stretched over duration, unless fixed with --tscale
     //tscale=1.0;
-    tscale=duration/(2.0*M_PI);
+    tscale=(fixed_tscale > 0.0) ? fixed_tscale : duration/(2.0*M_PI);
 
     //ascale=1.0;
-    ascale=0.2365893166123-rolling_deceleration;
+    ascale=EX3_AMPLITUDE-rolling_deceleration;
 
     //vscale=1.0;
-    vscale=ascale*duration/(2.0*M_PI);
+    vscale=ascale*tscale;
+
+    // With --arrive the profile keeps the period of the schedule duration (or --tscale) and rank 0 integrates it
+    // until the train reaches the target, so there is nothing for the other ranks to sweep
+    if(arrive_option != NULL)
+    {
+        if(my_rank == 0)
+        {
+            printf("Will find the arrival at %lf m with Dormand-Prince, atol=%le, rtol=%le, profile period %lf seconds\n",
+                   TargetPos, dopri_atol, dopri_rtol, 2.0*M_PI*tscale);
+
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            time_b = Simulate_Arrival(TargetPos, speed_limit, 2.0*duration);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            fstart=start.tv_sec + (start.tv_nsec / 1000000000.0);
+            fend=end.tv_sec + (end.tv_nsec / 1000000000.0);
+
+            if(time_b < 0.0)
+                printf("Train does not reach %lf m within %lf seconds\n", TargetPos, 2.0*duration);
+            else
+                printf("Arrival found in %lf seconds: train reaches %lf m at time %.9lf\n", (fend-fstart), TargetPos, time_b);
+        }
+
+        MPI_Finalize();
+        return;
+    }
+
+
+    if(parareal_option != NULL)
+    {
+        Parareal_Duration(duration, parareal_slices, coarse_steps, parareal_tol, my_rank, comm_sz);
+
+        MPI_Finalize();
+        return;
+    }
+
+    if(mc_option != NULL)
+    {
+        Monte_Carlo(mc_samples, &mc_config, duration, TargetPos, my_rank, comm_sz);
+
+        MPI_Finalize();
+        return;
+    }
+
+    if(sde_option != NULL)
+    {
+        Stochastic_Duration(sde_paths, &sde_config, sde_bands, duration, my_rank, comm_sz);
 
+        MPI_Finalize();
+        return;
+    }
+
+    if(ensemble_option != NULL)
+    {
+        Ensemble_Duration(duration, ensemble_trains, ensemble_drag, TargetPos, my_rank, comm_sz);
+
+        MPI_Finalize();
+        return;
+    }
+
+    // With --distribute every rank integrates its own slice of a single run of duration, so one long route can use
+    // all the ranks' threads
+    if(distribute_selected)
+    {
+        if(my_rank == 0)
+            printf("Will simulate %lf seconds split across %d ranks, with thread_count=%d, dt=%lf for %lu steps with integrator %s\n",
+                   duration, comm_sz, thread_count, dt, integration_steps, integrator_names[integrator_selected]);
+
+        MPI_Barrier(MPI_COMM_WORLD);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        Distributed_Duration(duration, my_rank, comm_sz, &VelStep, &PosStep);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        fstart=start.tv_sec + (start.tv_nsec / 1000000000.0);
+        fend=end.tv_sec + (end.tv_nsec / 1000000000.0);
+
+        if(my_rank == 0)
+            printf("Train from function in %lf seconds on %d ranks: final velocity = %lf, final position = %lf, remaining dist=%lf\n",
+                   (fend-fstart), comm_sz, VelStep, PosStep, TargetPos-PosStep);
+
+        MPI_Finalize();
+        return;
+    }
 
     // Rank 0, runs a full simulation which wil come up short of the target distance
     //
@@ -128,60 +430,12 @@ void main(int argc, char *argv[])
 
         printf("\n\nTHREADED INTEGRATOR %s: test for duration %lf seconds\n", integrator_names[integrator_selected], duration);
         clock_gettime(CLOCK_MONOTONIC, &start);
-        VelStep=0.0; PosStep=0.0;
 
         // Integrate the whole simulation in parallel based upon Oracle antiderivative
-
-        time_a = 0.0;
-        time_b = duration;
-
-        switch(integrator_selected)
-        {
-            case RIEMANN:
-                #pragma omp parallel num_threads(thread_count) reduction(+:VelStep)
-                VelStep += Local_Riemann(time_a, time_b, integration_steps, ex3_accel);
-
-                #pragma omp parallel num_threads(thread_count) reduction(+:PosStep)
-                PosStep += Local_Riemann(time_a, time_b, integration_steps, ex3_vel);
-
-                break;
-
-            case TRAPEZOIDAL:
-                #pragma omp parallel num_threads(thread_count) reduction(+:VelStep)
-                VelStep += Local_Trap(time_a, time_b, integration_steps, ex3_accel);
-
-                #pragma omp parallel num_threads(thread_count) reduction(+:PosStep)
-                PosStep += Local_Trap(time_a, time_b, integration_steps, ex3_vel);
-
-                break;
-
-
-            case SIMPSON:
-                #pragma omp parallel num_threads(thread_count) reduction(+:VelStep)
-                VelStep += Local_Simpson(time_a, time_b, integration_steps, ex3_accel);
-
-                #pragma omp parallel num_threads(thread_count) reduction(+:PosStep)
-                PosStep += Local_Simpson(time_a, time_b, integration_steps, ex3_vel);
-
-                break;
-
-            case RK4:
-                #pragma omp parallel num_threads(thread_count) reduction(+:VelStep)
-                VelStep += Local_RK4(time_a, time_b, integration_steps, ex3_accel);
-
-                #pragma omp parallel num_threads(thread_count) reduction(+:PosStep)
-                PosStep += Local_RK4(time_a, time_b, integration_steps, ex3_vel);
-
-                break;
-
-            default:
-                #pragma omp parallel num_threads(thread_count) reduction(+:VelStep)
-                VelStep += Local_Riemann(time_a, time_b, integration_steps, ex3_accel);
-
-                #pragma omp parallel num_threads(thread_count) reduction(+:PosStep)
-                PosStep += Local_Riemann(time_a, time_b, integration_steps, ex3_vel);
-        }
-
+        Fused_Start(&trial_state, 0.0, ex3_accel);
+        Simulate_Extend(&trial_state, duration, my_rank, 1);
+        VelStep = trial_state.vel;
+        PosStep = trial_state.pos;
 
         clock_gettime(CLOCK_MONOTONIC, &end);
         fstart=start.tv_sec + (start.tv_nsec / 1000000000.0);
@@ -201,6 +455,34 @@ void main(int argc, char *argv[])
     MPI_Barrier(MPI_COMM_WORLD);
     MPI_Bcast(&estTime, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
 
+    // With a fixed profile every rank can pick up where the trial left off
+    if(fixed_tscale > 0.0)
+    {
+        MPI_Bcast(&trial_state, sizeof(fused_state_t)/sizeof(double), MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        resume_state = &trial_state;
+    }
+
+    // With --search, refine the duration over several rounds instead of the single sweep below
+    if(search_option != NULL)
+    {
+        MPI_Bcast(&PosStep, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        time_b = Duration_Search(TargetPos, duration, PosStep, estTime, search_tol, my_rank, comm_sz, &search_rounds, &search_sims);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        fstart=start.tv_sec + (start.tv_nsec / 1000000000.0);
+        fend=end.tv_sec + (end.tv_nsec / 1000000000.0);
+
+        Simulate_Duration(time_b, my_rank, 0, &VelStep, &PosStep);
+
+        if(my_rank == 0)
+            printf("Duration search in %lf seconds: duration=%lf gives final position = %lf, error=%le after %d rounds of %d, %lu simulations\n",
+                   (fend-fstart), time_b, PosStep, PosStep - TargetPos, search_rounds, comm_sz, search_sims);
+
+        MPI_Finalize();
+        return;
+    }
+
     // Divide up duration search space between oringal duration and duration+estTime
     duration=duration + (estTime*(double)((double)(my_rank+1)/(double)comm_sz));
     printf("rank %d of %d, will run simulation for %lf time\n", my_rank, comm_sz, duration);
@@ -211,229 +493,953 @@ void main(int argc, char *argv[])
     time_a = 0.0;
     time_b = duration;
 
-    tscale=duration/(2.0*M_PI);
-    vscale=ascale*duration/(2.0*M_PI);
-
-
     printf("rank %d will simulate with thread_count=%d, with dt=%lf for %lu steps from a=%lf to b=%lf, for %lf seconds with integrator %s\n",
            my_rank, thread_count, dt, integration_steps, time_a, time_b, duration, integrator_names[integrator_selected]);
 
     printf("\n\nTHREADED INTEGRATOR %s: test for duration %lf seconds\n", integrator_names[integrator_selected], duration);
     clock_gettime(CLOCK_MONOTONIC, &start);
 
-    VelStep=0.0; PosStep=0.0;
-
     // Integrate the whole simulation in parallel based upon Oracle antiderivative
+    Simulate_Duration(duration, my_rank, 1, &VelStep, &PosStep);
 
-    switch(integrator_selected)
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    fstart=start.tv_sec + (start.tv_nsec / 1000000000.0);
+    fend=end.tv_sec + (end.tv_nsec / 1000000000.0);
+
+    aveVel=PosStep/duration;
+    distLeft=TargetPos-PosStep;
+    estTime = distLeft / aveVel;
+    targetErr = fabs(TargetPos - PosStep);
+
+    global_err.posErr=targetErr;
+    global_err.rank=my_rank;
+
+    printf("Rank %d, simulated train from function in %lf seconds: final velocity = %lf, final position = %lf, ave velocity=%lf, remaining dist=%lf, added time=%lf\n",
+           my_rank, (fend-fstart), VelStep, PosStep, aveVel, distLeft, estTime);
+
+    MPI_Allreduce(&targetErr, &leastErr, 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &global_err, 1, MPI_DOUBLE_INT, MPI_MINLOC, MPI_COMM_WORLD);
+
+    if(my_rank == 0) 
     {
-        case RIEMANN:
-            #pragma omp parallel num_threads(thread_count) reduction(+:VelStep)
-            VelStep += Local_Riemann(time_a, time_b, integration_steps, ex3_accel);
+        printf("rank = %d has leastErr=%lf, leastErr=%lf\n", global_err.rank, global_err.posErr, leastErr);
+    }
+
+    MPI_Finalize();
+
+}
+
 
-            #pragma omp parallel num_threads(thread_count) reduction(+:PosStep)
-            PosStep += Local_Riemann(time_a, time_b, integration_steps, ex3_vel);
+double Simulate_Arrival(double target_pos, double speed_limit, double t_max)
+{
+    double (*accel_ptr)(double) = ex3_accel, y0[2] = {0.0, 0.0}, rest_speed = REST_SPEED;
+    dopri_event_t events[3];
+    dopri_t dopri;
+    int hit;
 
-            break;
+    dopri_init(&dopri, 2, train_rhs, &accel_ptr, 0.0, y0, dopri_atol, dopri_rtol);
 
-        case TRAPEZOIDAL:
-            #pragma omp parallel num_threads(thread_count) reduction(+:VelStep)
-            VelStep += Local_Trap(time_a, time_b, integration_steps, ex3_accel);
+    events[0] = (dopri_event_t){ .g = train_position_event, .ctx = &target_pos, .direction = DOPRI_EVENT_RISING, .terminal = 1 };
+    events[1] = (dopri_event_t){ .g = train_velocity_event, .ctx = &speed_limit, .direction = DOPRI_EVENT_RISING };
+    events[2] = (dopri_event_t){ .g = train_velocity_event, .ctx = &rest_speed, .direction = DOPRI_EVENT_FALLING };
 
-            #pragma omp parallel num_threads(thread_count) reduction(+:PosStep)
-            PosStep += Local_Trap(time_a, time_b, integration_steps, ex3_vel);
+    dopri_events_init(&dopri, events, 3);
 
-            break;
+    if((hit = dopri_events(&dopri, t_max, events, 3)) < 0)
+        exit(-1);
 
+    printf("Dormand-Prince: %lu steps, %lu rejected, %lu evaluations\n", dopri.steps, dopri.rejected, dopri.evaluations);
 
-        case SIMPSON:
-            #pragma omp parallel num_threads(thread_count) reduction(+:VelStep)
-            VelStep += Local_Simpson(time_a, time_b, integration_steps, ex3_accel);
+    if((speed_limit > 0.0) && (events[1].count > 0))
+        printf("Speed limit %lf m/s first exceeded at time %lf, position %lf, %lu times in all\n",
+               speed_limit, events[1].t, events[1].y[1], events[1].count);
 
-            #pragma omp parallel num_threads(thread_count) reduction(+:PosStep)
-            PosStep += Local_Simpson(time_a, time_b, integration_steps, ex3_vel);
+    if(events[2].count > 0)
+        printf("Train comes to rest at time %lf, position %lf\n", events[2].t, events[2].y[1]);
 
-            break;
+    if(hit != 1)
+        return -1.0;
 
-        case RK4:
-            #pragma omp parallel num_threads(thread_count) reduction(+:VelStep)
-            VelStep += Local_RK4(time_a, time_b, integration_steps, ex3_accel);
+    printf("Arrival: velocity = %lf, position = %lf\n", events[0].y[0], events[0].y[1]);
 
-            #pragma omp parallel num_threads(thread_count) reduction(+:PosStep)
-            PosStep += Local_RK4(time_a, time_b, integration_steps, ex3_vel);
+    return events[0].t;
+}
 
-            break;
 
-        default:
-            #pragma omp parallel num_threads(thread_count) reduction(+:VelStep)
-            VelStep += Local_Riemann(time_a, time_b, integration_steps, ex3_accel);
+// Time decomposition of a single run
+//
+// The dt grid of [0, sim_duration] is split into one contiguous slice per rank (partition.h), and each rank
+// integrates its slice from rest with all its threads, giving the velocity change dv and the position change dx.
+// The slices are then stitched like the fused chunks (see fused.h): the velocity at the start of slice r is the
+// exclusive prefix sum of dv over the slices before it, and since a slice started at velocity v0 travels
+// v0*L further than from rest, its position contribution is dx + v0*L, whose exclusive prefix sum places the slice.
+// Two MPI_Exscan calls do the stitching, so the cost of the combine is two log(comm_sz) collectives.
+//
+// The quadrature paths integrate the ex3_vel oracle for position, which is already the absolute velocity, so their
+// slices skip the v0*L term.  The fixed dt rules see the same nodes as one run over the whole duration.
+//
+void Distributed_Duration(double sim_duration, int my_rank, int comm_sz, double *vel, double *pos)
+{
+    unsigned long steps = sim_duration / dt, first, last;
+    int from_rest = (integrator_selected == DOPRI5) || fused_selected;
+    double time_a, time_b, slice[2], offset[2] = {0.0, 0.0}, final[2];
+    fused_state_t state;
 
-            #pragma omp parallel num_threads(thread_count) reduction(+:PosStep)
-            PosStep += Local_Riemann(time_a, time_b, integration_steps, ex3_vel);
+    // one period over the whole run, as Simulate_Duration would use
+    if(fixed_tscale == 0.0)
+    {
+        tscale=sim_duration/(2.0*M_PI);
+        vscale=ascale*tscale;
     }
 
+    partition_static_range(0, steps, my_rank, comm_sz, &first, &last);
+    time_a = (double)first * dt;
+    time_b = (my_rank == comm_sz-1) ? sim_duration : (double)last * dt;
 
-    clock_gettime(CLOCK_MONOTONIC, &end);
-    fstart=start.tv_sec + (start.tv_nsec / 1000000000.0);
-    fend=end.tv_sec + (end.tv_nsec / 1000000000.0);
+    Fused_Start(&state, time_a, ex3_accel);
+    if(last > first)
+        Simulate_Extend(&state, time_b, my_rank, 0);
 
-    aveVel=PosStep/duration;
-    distLeft=TargetPos-PosStep;
-    estTime = distLeft / aveVel;
-    targetErr = fabs(TargetPos - PosStep);
+    printf("Rank %d, slice %lf to %lf (%lu steps): velocity change = %lf, position change = %lf\n",
+           my_rank, time_a, time_b, last-first, state.vel, state.pos);
 
-    global_err.posErr=targetErr;
-    global_err.rank=my_rank;
+    // velocity at the start of this slice, then its position contribution
+    MPI_Exscan(&state.vel, &offset[0], 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    if(my_rank == 0) offset[0] = 0.0;
 
-    printf("Rank %d, simulated train from function in %lf seconds: final velocity = %lf, final position = %lf, ave velocity=%lf, remaining dist=%lf, added time=%lf\n",
-           my_rank, (fend-fstart), VelStep, PosStep, aveVel, distLeft, estTime);
+    slice[0] = state.vel;
+    slice[1] = state.pos + (from_rest ? offset[0] * (time_b - time_a) : 0.0);
 
-    MPI_Allreduce(&targetErr, &leastErr, 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
-    MPI_Allreduce(MPI_IN_PLACE, &global_err, 1, MPI_DOUBLE_INT, MPI_MINLOC, MPI_COMM_WORLD);
+    MPI_Exscan(&slice[1], &offset[1], 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    if(my_rank == 0) offset[1] = 0.0;
 
-    if(my_rank == 0) 
+    // the last slice ends the run
+    final[0] = offset[0] + slice[0];
+    final[1] = offset[1] + slice[1];
+    MPI_Bcast(final, 2, MPI_DOUBLE, comm_sz-1, MPI_COMM_WORLD);
+
+    *vel = final[0];
+    *pos = final[1];
+}
+
+
+// MPI backend for Parareal: each rank fine solves a contiguous block of the remaining slices with its threads,
+// and since every slice is solved on exactly one rank, summing F across the ranks gathers it everywhere
+//
+typedef struct
+{
+    int my_rank, comm_sz;
+} parareal_mpi_t;
+
+static void parareal_fine_mpi(const parareal_t *p, int first, double (*U)[DOPRI_MAX_DIM], double (*F)[DOPRI_MAX_DIM], void *backend)
+{
+    parareal_mpi_t *mpi = backend;
+    unsigned long my_first, my_last;
+
+    partition_static_range(first, p->slices, mpi->my_rank, mpi->comm_sz, &my_first, &my_last);
+
+    memset(F[first], 0, sizeof(double) * DOPRI_MAX_DIM * (p->slices - first));
+    parareal_fine_range(p, (int)my_first, (int)my_last, U, F, thread_count);
+
+    MPI_Allreduce(MPI_IN_PLACE, F[first], DOPRI_MAX_DIM * (p->slices - first), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+}
+
+
+void Parareal_Duration(double sim_duration, int slices, unsigned long coarse_steps, double tol, int my_rank, int comm_sz)
+{
+    double (*U)[DOPRI_MAX_DIM] = malloc(sizeof(double) * DOPRI_MAX_DIM * (slices+1));
+    double y0[3] = {0.0, 0.0, 0.0}, y[3];
+    unsigned long steps = sim_duration / dt + 1.0e-6;
+    struct timespec start, end;
+    double parallel_time, sequential_time;
+    parareal_mpi_t mpi = {my_rank, comm_sz};
+    parareal_t p;
+    int status;
+
+    if(U == NULL)
     {
-        printf("rank = %d has leastErr=%lf, leastErr=%lf\n", global_err.rank, global_err.posErr, leastErr);
+        printf("Could not allocate %d Parareal slices\n", slices);
+        exit(-1);
     }
 
-    MPI_Finalize();
+    if(fixed_tscale == 0.0)
+    {
+        tscale=sim_duration/(2.0*M_PI);
+        vscale=ascale*tscale;
+    }
+
+    p = (parareal_t){ .rhs = train_ode_rhs, .project = train_ode_project, .ctx = &model, .dim = train_model_dim(&model), .t0 = 0.0, .t1 = sim_duration, .slices = slices,
+                      .fine_steps = (steps + slices - 1) / slices, .coarse_steps = coarse_steps, .tol = tol,
+                      .max_iter = slices };
+
+    if(my_rank == 0)
+        printf("Will simulate %lf seconds with Davis resistance A=%le B=%le C=%le%s by Parareal: %d slices of %lu fine RK4 steps, %lu coarse, tolerance %le, on %d ranks of %d threads\n",
+               sim_duration, model.davis_a, model.davis_b, model.davis_c, (model.track != NULL) ? ", grade and curves" : "", slices, p.fine_steps, coarse_steps, tol, comm_sz, thread_count);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    status = Parareal(&p, y0, U, (comm_sz > 1) ? parareal_fine_mpi : parareal_fine_omp, (comm_sz > 1) ? (void *)&mpi : (void *)&thread_count);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    parallel_time = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+
+    if(my_rank == 0)
+    {
+        printf("Parareal %s in %lf seconds: %d iterations, %lu fine slice solves, last change %le: final velocity = %lf, final position = %lf\n",
+               (status == 0) ? "converged" : "did not converge", parallel_time, p.iterations, p.fine_solves, p.change,
+               U[slices][0], U[slices][1]);
 
+        // the same fine steps in one sequential sweep
+        memcpy(y, y0, sizeof(y));
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        ode_rk4(train_ode_rhs, train_ode_project, &model, p.dim, 0.0, sim_duration, p.fine_steps * slices, y);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        sequential_time = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+
+        printf("Sequential RK4 in %lf seconds for %lu steps: final velocity = %lf, final position = %lf, Parareal difference %le m, speedup %lf\n",
+               sequential_time, p.fine_steps * slices, y[0], y[1], fabs(U[slices][1] - y[1]), sequential_time / parallel_time);
+
+        if(model.energy)
+            printf("Tractive energy = %lf kWh for mass %lf kg\n", U[slices][2] / 3.6e6, model.mass);
+    }
+
+    free(U);
 }
 
 
-double Local_Riemann(double a, double b, unsigned long n, double funct(double))
+// Parameters come from an additive recurrence (Kronecker sequence) over the global train index, frac(i*alpha) with
+// a different irrational alpha per parameter, so the ranks' trains are distinct, fill the ranges evenly, and are
+// the same for every run and thread count
+//
+void Ensemble_Duration(double sim_duration, int ntrains, double drag, double TargetPos, int my_rank, int comm_sz)
 {
-    double dt, interval_sum=0.0, local_a, local_b, time;
-    int my_rank = omp_get_thread_num();
-    int thread_count = omp_get_num_threads();
+    const double alpha[3] = {0.6180339887498949, 0.4142135623730950, 0.7320508075688772};   // phi-1, sqrt2-1, sqrt3-1
+    unsigned long steps = sim_duration / dt + 1.0e-6, global;
+    struct timespec start, end;
+    double elapsed, sums[2] = {0.0, 0.0}, pos_min, pos_max, reached = 0.0, y[2] = {0.0, 0.0};
+    ensemble_profile_t profile;
+    ensemble_t e;
+    train_model_t check;
+    int i;
 
-    dt = (b-a)/((double)n);
+    if(fixed_tscale == 0.0)
+        tscale=sim_duration/(2.0*M_PI);
 
-    unsigned long idx, local_n;
+    if(ensemble_alloc(&e, ntrains) < 0)
+        exit(-1);
 
-    local_n = n / thread_count;
+    for(i=0; i < ntrains; i++)
+    {
+        global = (unsigned long)my_rank * ntrains + i;
+        e.crr[i] = Crr_MIN + (Crr_MAX - Crr_MIN) * fmod((double)global * alpha[0], 1.0);
+        e.mass[i] = MASS_MIN + (MASS_MAX - MASS_MIN) * fmod((double)global * alpha[1], 1.0);
+        e.scale[i] = SCALE_MIN + (SCALE_MAX - SCALE_MIN) * fmod((double)global * alpha[2], 1.0);
+    }
 
-    local_a = a + my_rank*local_n*dt;
-    local_b = local_a + local_n*dt;
+    // the raw ex3 amplitude, since each train subtracts its own rolling resistance
+    profile = (ensemble_profile_t){ .amplitude = EX3_AMPLITUDE, .tscale = tscale, .drag = drag };
 
+    if(my_rank == 0)
+        printf("Will simulate %d trains on each of %d ranks for %lf seconds, with dt=%lf for %lu RK4 steps, %d threads\n",
+               ntrains, comm_sz, sim_duration, dt, steps, thread_count);
 
-    for(idx=1; idx <= local_n; idx++)
+    MPI_Barrier(MPI_COMM_WORLD);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    Ensemble_Propagate(&e, &profile, 0.0, sim_duration, steps, thread_count);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+
+    pos_min = pos_max = e.pos[0];
+    for(i=0; i < ntrains; i++)
     {
-        time = local_a + idx*dt;
-        interval_sum += (funct(time) * dt);
-        //printf("Step for my_rank=%d at time=%lf, f(t)=%lf, sum=%lf\n", my_rank, time, funct(time), interval_sum);
+        sums[0] += e.pos[i];
+        sums[1] += e.vel[i];
+        if(e.pos[i] < pos_min) pos_min = e.pos[i];
+        if(e.pos[i] > pos_max) pos_max = e.pos[i];
+        if(e.pos[i] >= TargetPos) reached += 1.0;
     }
 
-    //printf("Local Riemann = %lf for my_rank=%d of threads %d with dt=%lf, on a=%lf to b=%lf for %d steps\n",
-    //        interval_sum, my_rank, thread_count, dt, local_a, local_b, local_n);
+    MPI_Allreduce(MPI_IN_PLACE, sums, 2, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &reached, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &pos_min, 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &pos_max, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &elapsed, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+    if(my_rank == 0)
+    {
+        printf("Ensemble of %d trains in %lf seconds, %lf trains per second: final position mean = %lf, min = %lf, max = %lf, mean velocity = %lf, %.0lf reach %lf m\n",
+               ntrains * comm_sz, elapsed, (double)ntrains * comm_sz / elapsed, sums[0] / ((double)ntrains * comm_sz),
+               pos_min, pos_max, sums[1] / ((double)ntrains * comm_sz), reached, TargetPos);
+
+        // train 0 again through the scalar model, as a check on the SIMD kernel
+        train_model_init(&check, ex3_raw_accel);
+        check.accel_scale = e.scale[0];
+        check.davis_a = e.crr[0] * TRAIN_GRAVITY;
+        check.davis_c = drag / e.mass[0];
+        train_model_add(&check, train_force_davis);
+        ode_rk4(train_ode_rhs, train_ode_project, &check, 2, 0.0, sim_duration, steps, y);
+
+        printf("Train 0 (Crr=%lf, mass=%lf kg, scale=%lf): final position = %lf, scalar model = %lf, difference %le m\n",
+               e.crr[0], e.mass[0], e.scale[0], e.pos[0], y[1], fabs(e.pos[0] - y[1]));
+    }
 
-    return interval_sum;
+    ensemble_free(&e);
 }
 
 
-double Local_Trap(double a, double b, unsigned long n, double funct(double))
+// One thread's share of a Monte Carlo campaign
+typedef struct
 {
-    double dt = (b - a) / n;
-    double local_a, local_b, time, interval_sum;
-    int my_rank = omp_get_thread_num();
-    int thread_count = omp_get_num_threads();
-    unsigned long idx, local_n;
+    welford_t arrival, position;
+    qsketch_t arrival_q, position_q;
+    unsigned long unreached;
+    unsigned long failed;                   // non-physical parameters drawn, or Dormand-Prince could not step
+} mc_stats_t;
 
-    local_n = n / thread_count;
+static void mc_stats_init(mc_stats_t *st)
+{
+    welford_init(&st->arrival);
+    welford_init(&st->position);
+    qsketch_init(&st->arrival_q);
+    qsketch_init(&st->position_q);
+    st->unreached = 0;
+    st->failed = 0;
+}
 
-    local_a = a + my_rank*local_n*dt;
-    local_b = local_a + local_n*dt;
+static void mc_stats_merge(mc_stats_t *st, const mc_stats_t *other)
+{
+    welford_merge(&st->arrival, &other->arrival);
+    welford_merge(&st->position, &other->position);
+    qsketch_merge(&st->arrival_q, &other->arrival_q);
+    qsketch_merge(&st->position_q, &other->position_q);
+    st->unreached += other->unreached;
+    st->failed += other->failed;
+}
 
-    interval_sum = (funct(local_a) + funct(local_b)) / 2.0;
+// MPI datatype of a welford_t, from the addresses of its members so it doesn't depend on the struct's layout, and
+// resized to the struct so that arrays of them can be sent - MPI_Type_free it after use
+static MPI_Datatype mpi_welford_type(void)
+{
+    welford_t w = {0};
+    int lengths[5] = {1, 1, 1, 1, 1}, k;
+    MPI_Datatype types[5] = {MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE}, fields, type;
+    MPI_Aint base, disp[5];
+
+    MPI_Get_address(&w, &base);
+    MPI_Get_address(&w.n, &disp[0]);
+    MPI_Get_address(&w.mean, &disp[1]);
+    MPI_Get_address(&w.m2, &disp[2]);
+    MPI_Get_address(&w.min, &disp[3]);
+    MPI_Get_address(&w.max, &disp[4]);
+    for(k=0; k < 5; k++)
+        disp[k] = MPI_Aint_diff(disp[k], base);
+
+    MPI_Type_create_struct(5, lengths, disp, types, &fields);
+    MPI_Type_create_resized(fields, 0, sizeof(welford_t), &type);
+    MPI_Type_commit(&type);
+    MPI_Type_free(&fields);
+
+    return type;
+}
+
+// Sum a quantile sketch over the ranks onto rank 0 - its counts and total packed into one buffer, so it is one
+// message without relying on the members being adjacent
+static void qsketch_reduce(qsketch_t *s, int my_rank)
+{
+    double buffer[QSKETCH_BUCKETS+1];
 
-    for (idx = 1; idx < local_n; idx++)
+    memcpy(buffer, s->count, sizeof(s->count));
+    buffer[QSKETCH_BUCKETS] = s->total;
+
+    MPI_Reduce((my_rank == 0) ? MPI_IN_PLACE : buffer, buffer, QSKETCH_BUCKETS+1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    if(my_rank == 0)
     {
-        time = local_a + idx * dt;
-        interval_sum += funct(time);
+        memcpy(s->count, buffer, sizeof(s->count));
+        s->total = buffer[QSKETCH_BUCKETS];
     }
+}
 
-    return dt * interval_sum;
+static void mc_stats_print(const char *name, const char *units, const welford_t *w, const qsketch_t *q)
+{
+    printf("%s: %.0lf samples, mean = %lf %s, sd = %lf, min = %lf, max = %lf\n", name, w->n, w->mean, units,
+           welford_sd(w), w->min, w->max);
+    printf("    quantiles 1%% = %lf, 5%% = %lf, 50%% = %lf, 95%% = %lf, 99%% = %lf (within %.1lf%%)\n",
+           qsketch_quantile(q, 0.01), qsketch_quantile(q, 0.05), qsketch_quantile(q, 0.5), qsketch_quantile(q, 0.95),
+           qsketch_quantile(q, 0.99), 100.0*QSKETCH_ALPHA);
 }
 
 
-double Local_Simpson(double a, double b, unsigned long n, double funct(double))
+// Monte Carlo campaign
+//
+// Each rank takes a contiguous share of the samples, split over its threads.  Sample i draws its parameters from
+// Philox stream i of the seed, so every sample is the same train whichever rank and thread runs it, and the
+// quantiles and unreached count are the same for any ranks and threads - the moments to rounding, since they are
+// summed in a different order.  Every thread accumulates its own statistics; they are merged in thread order and
+// then the ranks' in rank order, so memory is constant in the number of samples.
+//
+void Monte_Carlo(unsigned long samples, const mc_config_t *config, double sim_duration, double TargetPos, int my_rank, int comm_sz)
 {
-    double dt = (b - a) / n;
-    double interval_sum = 0.0;
-    double local_a, local_b, time, fx;
-    int my_rank = omp_get_thread_num();
-    int thread_count = omp_get_num_threads();
-    unsigned long idx, local_n;
-
-    local_n = n / thread_count;
-
-    local_a = a + my_rank*local_n*dt;
-    local_b = local_a + local_n*dt;
-
-    for (idx = 1; idx <= local_n; idx++)
-    {
-        time = local_a + idx * dt;
-        fx = funct(time);
-
-        // See https://en.wikipedia.org/wiki/Simpson's_rule for more information
-        //
-        // 1) on the first we evaluate f(a) and on the last we evaluate f(b)
-        // 2) for steps between we alternate between (4/3)f(a+b) and (2/3)f(a+b)
-        // 3) at the end we return h times the weighted sum of all the 1/3, 4/3, 2/3 summation
-        //    terms.
-        //
-        if (idx == 0 || idx == local_n)
+    mc_stats_t *thread_stats = malloc(sizeof(mc_stats_t) * thread_count), total;
+    welford_t *rank_moments = malloc(sizeof(welford_t) * 2 * comm_sz), moments[2];
+    MPI_Datatype welford_type;
+    unsigned long first, last, unreached, failed;
+    struct timespec start, end;
+    double elapsed;
+    int t;
+
+    if((thread_stats == NULL) || (rank_moments == NULL))
+    {
+        printf("Could not allocate Monte Carlo statistics for %d threads\n", thread_count);
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
+
+    if(fixed_tscale == 0.0)
+        tscale=sim_duration/(2.0*M_PI);
+
+    if(my_rank == 0)
+    {
+        printf("Will run %lu Monte Carlo samples of %lf seconds on %d ranks of %d threads with seed %lu, drag %lf:\n",
+               samples, sim_duration, comm_sz, thread_count, (unsigned long)config->seed, config->drag);
+        dist_print("Crr", &config->crr);
+        dist_print("mass", &config->mass);
+        dist_print("scale", &config->scale);
+    }
+
+    partition_static_range(0, samples, my_rank, comm_sz, &first, &last);
+
+    // all of them, in case the team is smaller than asked for
+    for(t=0; t < thread_count; t++)
+        mc_stats_init(&thread_stats[t]);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    #pragma omp parallel num_threads(thread_count)
+    {
+        mc_stats_t *st = &thread_stats[omp_get_thread_num()];
+        double y0[2] = {0.0, 0.0}, target = TargetPos, crr, mass, scale, position;
+        unsigned long i;
+        philox_t rng;
+        train_model_t m;
+        dopri_event_t arrive;
+        dopri_t dopri;
+
+        #pragma omp for schedule(dynamic, 64)
+        for(i=first; i < last; i++)
         {
-            interval_sum += fx;
+            philox_init(&rng, config->seed, i);
+
+            crr = dist_sample(&config->crr, &rng);
+            mass = dist_sample(&config->mass, &rng);
+            scale = dist_sample(&config->scale, &rng);
+
+            // the tail of a distribution past zero is a train that can't be simulated, which is counted as failed
+            // rather than stopping the campaign - and so is one Dormand-Prince can't step through
+            if((crr < 0.0) || (mass <= 0.0) || (scale <= 0.0))
+            {
+                st->failed++;
+                continue;
+            }
+
+            train_model_init(&m, ex3_raw_accel);
+            m.davis_a = crr * TRAIN_GRAVITY;
+            m.davis_c = config->drag / mass;
+            m.accel_scale = scale;
+            train_model_add(&m, train_force_davis);
+
+            dopri_init(&dopri, 2, train_ode_rhs, &m, 0.0, y0, dopri_atol, dopri_rtol);
+            arrive = (dopri_event_t){ .g = train_position_event, .ctx = &target, .direction = DOPRI_EVENT_RISING };
+            dopri_events_init(&dopri, &arrive, 1);
+
+            if(dopri_events(&dopri, sim_duration, &arrive, 1) < 0)
+            {
+                st->failed++;
+                continue;
+            }
+
+            position = dopri.y[1];
+
+            // not there yet, so carry on until it is
+            if(arrive.count == 0)
+            {
+                arrive.terminal = 1;
+                if(dopri_events(&dopri, MC_HORIZON * sim_duration, &arrive, 1) < 0)
+                {
+                    st->failed++;
+                    continue;
+                }
+            }
+
+            welford_add(&st->position, position);
+            qsketch_add(&st->position_q, position);
+
+            if(arrive.count > 0)
+            {
+                welford_add(&st->arrival, arrive.t);
+                qsketch_add(&st->arrival_q, arrive.t);
+            }
+            else
+                st->unreached++;
         }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+
+    total = thread_stats[0];
+    for(t=1; t < thread_count; t++)
+        mc_stats_merge(&total, &thread_stats[t]);
+
+    // moments are merged pairwise in rank order on rank 0, quantile buckets and counts just summed
+    welford_type = mpi_welford_type();
+    moments[0] = total.arrival;
+    moments[1] = total.position;
+    MPI_Gather(moments, 2, welford_type, rank_moments, 2, welford_type, 0, MPI_COMM_WORLD);
+    MPI_Type_free(&welford_type);
 
-        // Alternating 4/3 and 2/3 weighting for points between f(a) and f(b)
-        else if (idx % 2 == 1)
+    qsketch_reduce(&total.arrival_q, my_rank);
+    qsketch_reduce(&total.position_q, my_rank);
+    MPI_Reduce(&total.unreached, &unreached, 1, MPI_UNSIGNED_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&total.failed, &failed, 1, MPI_UNSIGNED_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &elapsed, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+    if(my_rank == 0)
+    {
+        for(t=1; t < comm_sz; t++)
         {
-            interval_sum += 4.0 * fx;
+            welford_merge(&total.arrival, &rank_moments[2*t]);
+            welford_merge(&total.position, &rank_moments[2*t+1]);
         }
-        else
+
+        printf("Monte Carlo of %lu samples in %lf seconds, %lf samples per second, %lu do not reach %lf m within %lf seconds\n",
+               samples, elapsed, (double)samples / elapsed, unreached, TargetPos, MC_HORIZON * sim_duration);
+
+        if(failed > 0)
+            printf("%lu samples failed, with a Crr below 0, a mass or scale of 0 or below, or a step size underflow\n", failed);
+        mc_stats_print("Arrival time", "s", &total.arrival, &total.arrival_q);
+        mc_stats_print("Position at end of duration", "m", &total.position, &total.position_q);
+    }
+
+    free(thread_stats);
+    free(rank_moments);
+}
+
+
+// Percentile bands of one variable at every band time
+static void sde_bands_print(const char *name, const double *time, const welford_t *w, const qsketch_t *q, int nbands)
+{
+    static const double percent[5] = {5.0, 25.0, 50.0, 75.0, 95.0};
+    int k, j;
+
+    printf("%s:\n    %12s %14s %14s", name, "time", "mean", "sd");
+    for(j=0; j < 5; j++)
+        printf(" %13.0lf%%", percent[j]);
+    printf("\n");
+
+    for(k=0; k < nbands; k++)
+    {
+        printf("    %12.3lf %14.6lf %14.6lf", time[k], w[k].mean, welford_sd(&w[k]));
+        for(j=0; j < 5; j++)
+            printf(" %14.6lf", qsketch_quantile(&q[k], percent[j] / 100.0));
+        printf("\n");
+    }
+}
+
+
+// Stochastic paths
+//
+// Each rank propagates a contiguous share of the paths, and every path draws its noise from its own Philox stream,
+// so the bands are the same for any ranks and threads (the moments to rounding).  The ranks' moments are merged in
+// rank order on rank 0 and their quantile sketches summed.
+//
+void Stochastic_Duration(unsigned long paths, const sde_model_t *config, int nbands, double sim_duration, int my_rank, int comm_sz)
+{
+    unsigned long steps = sim_duration / dt + 1.0e-6, first, last;
+    welford_t *rank_vel, *rank_pos;
+    MPI_Datatype welford_type;
+    struct timespec start, end;
+    double elapsed;
+    sde_model_t m = *config;
+    sde_bands_t bands;
+    int k, r;
+
+    if(fixed_tscale == 0.0)
+        tscale=sim_duration/(2.0*M_PI);
+
+    // the raw ex3 amplitude, since the model subtracts its own rolling resistance
+    m.amplitude = EX3_AMPLITUDE;
+    m.tscale = tscale;
+
+    if((10.0*dt > m.wind_tau) || (10.0*dt > m.adhesion_tau) || (nbands < 1) || (steps < 1))
+    {
+        if(my_rank == 0)
+            printf("Euler-Maruyama needs dt=%lf under a tenth of the correlation times %lf and %lf, and at least one band and step\n",
+                   dt, m.wind_tau, m.adhesion_tau);
+        MPI_Finalize();
+        exit(-1);
+    }
+
+    rank_vel = malloc(sizeof(welford_t) * nbands * comm_sz);
+    rank_pos = malloc(sizeof(welford_t) * nbands * comm_sz);
+
+    if((rank_vel == NULL) || (rank_pos == NULL) || (sde_bands_alloc(&bands, nbands) < 0))
+    {
+        printf("Could not allocate the band statistics for %d ranks\n", comm_sz);
+        exit(-1);
+    }
+
+    if(my_rank == 0)
+    {
+        printf("Will simulate %lu paths on %d ranks of %d threads for %lf seconds by Euler-Maruyama at dt=%lf, seed %lu\n",
+               paths, comm_sz, thread_count, sim_duration, dt, (unsigned long)m.seed);
+        printf("    Crr = %lf, mass = %lf kg, drag = %lf, wind sd = %lf m/s tau = %lf s, adhesion sd = %lf tau = %lf s\n",
+               m.crr, m.mass, m.drag, m.wind_sd, m.wind_tau, m.adhesion_sd, m.adhesion_tau);
+    }
+
+    partition_static_range(0, paths, my_rank, comm_sz, &first, &last);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if(SDE_Propagate(&m, first, last - first, sim_duration, steps, &bands, thread_count) < 0)
+        exit(-1);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+
+    welford_type = mpi_welford_type();
+    MPI_Gather(bands.vel, nbands, welford_type, rank_vel, nbands, welford_type, 0, MPI_COMM_WORLD);
+    MPI_Gather(bands.pos, nbands, welford_type, rank_pos, nbands, welford_type, 0, MPI_COMM_WORLD);
+    MPI_Type_free(&welford_type);
+
+    for(k=0; k < nbands; k++)
+    {
+        qsketch_reduce(&bands.vel_q[k], my_rank);
+        qsketch_reduce(&bands.pos_q[k], my_rank);
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &elapsed, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+    if(my_rank == 0)
+    {
+        for(r=1; r < comm_sz; r++)
+            for(k=0; k < nbands; k++)
+            {
+                welford_merge(&bands.vel[k], &rank_vel[r*nbands + k]);
+                welford_merge(&bands.pos[k], &rank_pos[r*nbands + k]);
+            }
+
+        printf("Euler-Maruyama of %lu paths in %lf seconds, %lf path steps per second\n",
+               paths, elapsed, (double)paths * steps / elapsed);
+        sde_bands_print("Velocity, m/s", bands.time, bands.vel, bands.vel_q, nbands);
+        sde_bands_print("Position, m", bands.time, bands.pos, bands.pos_q, nbands);
+    }
+
+    sde_bands_free(&bands);
+    free(rank_vel);
+    free(rank_pos);
+}
+
+void Simulate_Duration(double sim_duration, int my_rank, int verbose, double *vel, double *pos)
+{
+    fused_state_t state;
+
+    if((resume_state != NULL) && (sim_duration >= resume_state->time))
+    {
+        state = *resume_state;
+
+        if(verbose)
+            printf("Rank %d, resuming from the trial at time %lf: velocity = %lf, position = %lf\n",
+                   my_rank, state.time, state.vel, state.pos);
+    }
+    else
+    {
+        // the sine curve is stretched over the duration simulated
+        if(fixed_tscale == 0.0)
         {
-            interval_sum += 2.0 * fx;
+            tscale=sim_duration/(2.0*M_PI);
+            vscale=ascale*tscale;
         }
+
+        Fused_Start(&state, 0.0, ex3_accel);
     }
 
-    // h=(b-a)/n, sum= [f(a) + f(b)] + (4 or 2)*f(a+b), all multipied by 1/3
-    return dt * interval_sum / 3.0;
+    Simulate_Extend(&state, sim_duration, my_rank, verbose);
+
+    *vel = state.vel;
+    *pos = state.pos;
 }
 
 
-double Local_RK4(double a, double b, unsigned long n, double funct(double))
+// The velocity and position integrals are additive over time, so the quadrature paths just add the integrals over
+// [state->time, t_end], while the paths that step the state - Dormand-Prince and fused - continue from it
+//
+void Simulate_Extend(fused_state_t *state, double t_end, int my_rank, int verbose)
 {
-    double dt = (b - a) / n;
-    double interval_sum = 0.0;
-    double local_a, local_b, time, k1, k2, k3, k4;
-    int my_rank = omp_get_thread_num();
-    int thread_count = omp_get_num_threads();
-    unsigned long idx, local_n;
+    // a span of a whole number of dt must not lose a step to rounding, as the --distribute slices are
+    unsigned long integration_steps = (t_end - state->time) / dt + 1.0e-6;
+    double time_a = state->time, time_b = t_end, vel_sum = 0.0, pos_sum = 0.0;
+    double (*accel_ptr)(double) = ex3_accel, y0[2] = {state->vel, state->pos};
+    dopri_t dopri;
+    romberg_t romberg_vel, romberg_pos;
+
+    // Dormand-Prince adapts its own step to --atol/--rtol, so dt is not used, and integrates velocity and
+    // position together on one thread since each step depends on the last
+    if(integrator_selected == DOPRI5)
+    {
+        dopri_init(&dopri, 2, train_rhs, &accel_ptr, time_a, y0, dopri_atol, dopri_rtol);
 
-    local_n = n / thread_count;
+        if(dopri_integrate(&dopri, time_b) < 0)
+            exit(-1);
 
-    local_a = a + my_rank*local_n*dt;
-    local_b = local_a + local_n*dt;
+        vel_sum = dopri.y[0] - state->vel;
+        pos_sum = dopri.y[1] - state->pos;
 
+        if(verbose) printf("Rank %d, Dormand-Prince: %lu steps, %lu rejected, %lu evaluations, error estimate vel=%le pos=%le\n",
+                           my_rank, dopri.steps, dopri.rejected, dopri.evaluations, dopri.err_sum[0], dopri.err_sum[1]);
+    }
 
-    // March from a to b in n uniform steps
-    for (idx = 1; idx <= local_n; idx++)
+    // Romberg refines its own trapezoidal grid until --tol is met, reusing every coarser sample, so dt is not used
+    else if(integrator_selected == ROMBERG)
     {
-        time = local_a + idx * dt;
+        vel_sum = Romberg(time_a, time_b, ex3_accel, romberg_tol, thread_count, &romberg_vel);
+        pos_sum = Romberg(time_a, time_b, ex3_vel, romberg_tol, thread_count, &romberg_pos);
+        if(verbose) printf("Rank %d, Romberg: velocity %d levels, position %d levels, %lu evaluations, error estimate vel=%le pos=%le\n",
+                           my_rank, romberg_vel.levels, romberg_pos.levels, romberg_vel.evaluations + romberg_pos.evaluations,
+                           romberg_vel.error, romberg_pos.error);
+    }
 
-        // RK4 stages: k1..k4 evaluate f at time, time+dt/2, time+dt
-        k1 = funct(time);
-        k2 = funct(time + 0.5 * dt);
-        k3 = funct(time + 0.5 * dt);
-        k4 = funct(time + dt);
+    // Gauss-Legendre uses --order nodes on each of --panels panels, so dt is not used
+    else if(integrator_selected == GAUSS_LEGENDRE)
+    {
+        vel_sum = Gauss_Legendre(time_a, time_b, ex3_accel, gauss_order, gauss_panels, thread_count);
+        pos_sum = Gauss_Legendre(time_a, time_b, ex3_vel, gauss_order, gauss_panels, thread_count);
+        if(verbose) printf("Rank %d, Gauss-Legendre: order %d on %lu panels, %lu evaluations\n", my_rank, gauss_order, gauss_panels, 2*gauss_order*gauss_panels);
+    }
 
-        // Update the integral using RK4 combination
-        interval_sum += k1 + 2.0*k2 + 2.0*k3 + k4;
+    // The fused path integrates only the acceleration, advancing velocity and position together in one sweep
+    else if(fused_selected)
+    {
+        Fused_Extend(state, integrator_selected, time_b, integration_steps, ex3_accel, thread_count);
+        return;
     }
 
-    return dt * interval_sum / 6.0;
+    // The batch path runs the same rules on blocks of oracle samples generated with SIMD
+    else if(batch_selected)
+    {
+        #pragma omp parallel num_threads(thread_count) reduction(+:vel_sum)
+        vel_sum += Local_Batch(integrator_selected, time_a, time_b, integration_steps, ex3_accel_batch, schedule);
+
+        #pragma omp parallel num_threads(thread_count) reduction(+:pos_sum)
+        pos_sum += Local_Batch(integrator_selected, time_a, time_b, integration_steps, ex3_vel_batch, schedule);
+    }
+    else
+    {
+    switch(integrator_selected)
+        {
+            case RIEMANN:
+                #pragma omp parallel num_threads(thread_count) reduction(+:vel_sum)
+                vel_sum += Local_Riemann(time_a, time_b, integration_steps, ex3_accel);
+
+                #pragma omp parallel num_threads(thread_count) reduction(+:pos_sum)
+                pos_sum += Local_Riemann(time_a, time_b, integration_steps, ex3_vel);
+
+                break;
+
+            case TRAPEZOIDAL:
+                #pragma omp parallel num_threads(thread_count) reduction(+:vel_sum)
+                vel_sum += Local_Trap(time_a, time_b, integration_steps, ex3_accel);
+
+                #pragma omp parallel num_threads(thread_count) reduction(+:pos_sum)
+                pos_sum += Local_Trap(time_a, time_b, integration_steps, ex3_vel);
+
+                break;
+
+
+            case SIMPSON:
+                #pragma omp parallel num_threads(thread_count) reduction(+:vel_sum)
+                vel_sum += Local_Simpson(time_a, time_b, integration_steps, ex3_accel);
+
+                #pragma omp parallel num_threads(thread_count) reduction(+:pos_sum)
+                pos_sum += Local_Simpson(time_a, time_b, integration_steps, ex3_vel);
+
+                break;
+
+            case RK4:
+                #pragma omp parallel num_threads(thread_count) reduction(+:vel_sum)
+                vel_sum += Local_RK4(time_a, time_b, integration_steps, ex3_accel);
+
+                #pragma omp parallel num_threads(thread_count) reduction(+:pos_sum)
+                pos_sum += Local_RK4(time_a, time_b, integration_steps, ex3_vel);
+
+                break;
+
+            default:
+                #pragma omp parallel num_threads(thread_count) reduction(+:vel_sum)
+                vel_sum += Local_Riemann(time_a, time_b, integration_steps, ex3_accel);
+
+                #pragma omp parallel num_threads(thread_count) reduction(+:pos_sum)
+                pos_sum += Local_Riemann(time_a, time_b, integration_steps, ex3_vel);
+        }
+    }
+
+    state->vel += vel_sum;
+    state->pos += pos_sum;
+    state->accel = ex3_accel(t_end);
+    state->time = t_end;
+}
+
+
+// Parallel duration search
+//
+// The final position is a smooth, increasing function of the duration, so the duration reaching TargetPos is the
+// root of f(d) = position(d) - TargetPos.  Every round each rank simulates one duration, the (d, f) pairs are
+// gathered to all ranks, and every rank narrows the bracket the same way:
+//
+// 1) until the root is bracketed, the ranks spread out from d0 toward d0 + 2*estTime, doubling the reach each
+//    round that finds no sign change
+// 2) then rank 0 tries the secant (regula falsi) estimate from the bracket ends, while the other ranks split the
+//    bracket into equal parts - the bracket shrinks by at least comm_sz per round, and usually collapses around
+//    the secant estimate.  On a single rank, rounds alternate between secant and bisection.
+//
+// The search ends when a simulated position is within postol meters of TargetPos.  Returns the best duration
+// found, with the number of rounds and simulations (not counting rank 0's trial run).
+//
+double Duration_Search(double TargetPos, double d0, double pos0, double estTime, double postol, int my_rank, int comm_sz,
+                       int *rounds, unsigned long *sims)
+{
+    double lo = d0, flo = pos0 - TargetPos, hi = d0, fhi = flo;
+    double reach = 2.0*fabs(estTime), direction = (flo < 0.0) ? 1.0 : -1.0;
+    double best = d0, fbest = flo, mine[2], vel, pos, secant;
+    double *pts = malloc(sizeof(double) * 2*(comm_sz+2));
+    int bracketed = 0, round, idx, jdx;
+
+    if(pts == (double *)0)
+    {
+        printf("Duration_Search: could not allocate %d points\n", comm_sz+2);
+        exit(-1);
+    }
+
+    if(reach == 0.0) reach = 0.01*d0;
+    *sims = 0;
+
+    for(round=1; (round <= SEARCH_MAX_ROUNDS) && (fabs(fbest) > postol); round++)
+    {
+        // 1) choose this rank's duration
+        if(!bracketed)
+            mine[0] = lo + direction*reach*(double)(my_rank+1)/(double)comm_sz;
+        else
+        {
+            secant = lo - flo*(hi - lo)/(fhi - flo);
+
+            // keep clear of the ends, which are already known
+            if(secant < lo + 0.001*(hi - lo)) secant = lo + 0.001*(hi - lo);
+            if(secant > hi - 0.001*(hi - lo)) secant = hi - 0.001*(hi - lo);
+
+            if(comm_sz == 1)
+                mine[0] = (round % 2) ? secant : 0.5*(lo + hi);
+            else
+                mine[0] = (my_rank == 0) ? secant : lo + (hi - lo)*(double)my_rank/(double)comm_sz;
+        }
+
+        Simulate_Duration(mine[0], my_rank, 0, &vel, &pos);
+        mine[1] = pos - TargetPos;
+
+        // 2) share every rank's (d, f), in rank order after the two bracket ends
+        pts[0] = lo; pts[1] = flo;
+        pts[2] = hi; pts[3] = fhi;
+        MPI_Allgather(mine, 2, MPI_DOUBLE, &pts[4], 2, MPI_DOUBLE, MPI_COMM_WORLD);
+        *sims += comm_sz;
+
+        for(idx=2; idx < comm_sz+2; idx++)
+        {
+            if(fabs(pts[2*idx+1]) < fabs(fbest))
+            {
+                best = pts[2*idx];
+                fbest = pts[2*idx+1];
+            }
+        }
+
+        // 3) narrow the bracket
+        if(!bracketed)
+        {
+            // the new points run outward from lo, so the first sign change is the bracket
+            for(idx=2; idx < comm_sz+2; idx++)
+            {
+                if((pts[2*idx+1] < 0.0) != (flo < 0.0))
+                {
+                    hi = pts[2*idx]; fhi = pts[2*idx+1];
+                    bracketed = 1;
+                    break;
+                }
+
+                lo = pts[2*idx]; flo = pts[2*idx+1];
+            }
+
+            if(!bracketed)
+                reach *= 2.0;
+            else if(hi < lo)
+            {
+                secant = lo; lo = hi; hi = secant;
+                secant = flo; flo = fhi; fhi = secant;
+            }
+        }
+        else
+        {
+            // sort by duration (a handful of points) and take the first sign change
+            for(idx=1; idx < comm_sz+2; idx++)
+            {
+                for(jdx=idx; (jdx > 0) && (pts[2*jdx] < pts[2*(jdx-1)]); jdx--)
+                {
+                    mine[0] = pts[2*jdx]; mine[1] = pts[2*jdx+1];
+                    pts[2*jdx] = pts[2*(jdx-1)]; pts[2*jdx+1] = pts[2*(jdx-1)+1];
+                    pts[2*(jdx-1)] = mine[0]; pts[2*(jdx-1)+1] = mine[1];
+                }
+            }
+
+            for(idx=0; idx < comm_sz+1; idx++)
+            {
+                if((pts[2*idx+1] < 0.0) != (pts[2*idx+3] < 0.0))
+                {
+                    lo = pts[2*idx]; flo = pts[2*idx+1];
+                    hi = pts[2*idx+2]; fhi = pts[2*idx+3];
+                    break;
+                }
+            }
+        }
+
+        if(my_rank == 0)
+            printf("Search round %d: %s [%lf, %lf], best duration=%lf with position error %le\n",
+                   round, bracketed ? "bracket" : "searching", lo, hi, best, fbest);
+    }
+
+    *rounds = round-1;
+    free(pts);
+
+    return best;
+}
+
+
+double Local_Riemann(double a, double b, unsigned long n, double funct(double))
+{
+    return Local_Rule(RIEMANN, a, b, n, funct, schedule);
+}
+
+
+double Local_Trap(double a, double b, unsigned long n, double funct(double))
+{
+    return Local_Rule(TRAPEZOIDAL, a, b, n, funct, schedule);
+}
+
+
+double Local_Simpson(double a, double b, unsigned long n, double funct(double))
+{
+    return Local_Rule(SIMPSON, a, b, n, funct, schedule);
+}
+
+
+double Local_RK4(double a, double b, unsigned long n, double funct(double))
+{
+    return Local_Rule(RK4, a, b, n, funct, schedule);
 }
 
 
@@ -443,8 +1449,39 @@ double ex3_accel(double time)
 }
 
 
+double ex3_raw_accel(double time)
+{
+    return (sin(time/tscale)*EX3_AMPLITUDE);
+}
+
+
 // determined based on known anti-derivative of ex4_accel function
 double ex3_vel(double time)
 {
     return ((-cos(time/tscale)+1)*vscale);
 }
+
+
+// n must be at most BATCH_SIZE, as it is from Local_Batch
+void ex3_accel_batch(double t0, double dt, unsigned long n, double *out)
+{
+    double cos_out[BATCH_SIZE];
+    unsigned long k;
+
+    sincos_batch(t0/tscale, dt/tscale, n, out, cos_out);
+
+    for(k=0; k < n; k++)
+        out[k] *= ascale;
+}
+
+
+void ex3_vel_batch(double t0, double dt, unsigned long n, double *out)
+{
+    double sin_out[BATCH_SIZE];
+    unsigned long k;
+
+    sincos_batch(t0/tscale, dt/tscale, n, sin_out, out);
+
+    for(k=0; k < n; k++)
+        out[k] = (-out[k]+1)*vscale;
+}
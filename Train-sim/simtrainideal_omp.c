@@ -4,6 +4,13 @@
 #include <time.h>
 #include <omp.h>
 
+#include "batch.h"
+#include "fused.h"
+#include "dopri5.h"
+#include "quadrature.h"
+#include "rules.h"
+#include "simopts.h"
+
 // Coefficient of Rolling Resistance from https://youtu.be/-KAVJH_Dl80
 //
 // Force_rolling_resist = m*accel
@@ -29,17 +36,26 @@ double tscale, ascale, vscale; //computed in main based on actual duration
 double ex3_accel(double time);
 double ex3_vel(double time);
 
-// Implement methods of integration for OpenMP
+// the same oracles for a block of up to BATCH_SIZE samples on a uniform grid, with --batch
+void ex3_accel_batch(double t0, double dt, unsigned long n, double *out);
+void ex3_vel_batch(double t0, double dt, unsigned long n, double *out);
+
+// Implement methods of integration for OpenMP, with the steps split across threads by --schedule (see partition.h)
+partition_schedule_t schedule;
+
 double Local_Riemann(double a, double b, unsigned long n, double func(double));
 double Local_Trap(double a, double b, unsigned long n, double func(double));
 double Local_Simpson(double a, double b, unsigned long n, double func(double));
 double Local_RK4(double a, double b, unsigned long n, double func(double));
 
-char *integrator_names[]={"Riemann", "Trapezoidal", "Simpson", "Runge-Kutta-4"};
+char *integrator_names[]={"Riemann", "Trapezoidal", "Simpson", "Runge-Kutta-4", "Dormand-Prince-5(4)", "Romberg", "Gauss-Legendre"};
 #define RIEMANN 0
 #define TRAPEZOIDAL 1
 #define SIMPSON 2
 #define RK4 3
+#define DOPRI5 4
+#define ROMBERG 5
+#define GAUSS_LEGENDRE 6
 
 
 void main(int argc, char *argv[])
@@ -53,32 +69,56 @@ void main(int argc, char *argv[])
     struct timespec start, end;
     double fstart, fend;
     double TargetPos=122000.0;
-
-    printf("\nUse: simtrain [threads] [dt] [duration] [integrator is 0=Riemann, 1=Trap, 2=Simpsons, 3=RK4]\n");
-
-    if(argc == 2)
+    char *posv[argc+1];
+    int posc = sim_positional(argc, argv, posv);
+    int batch_selected = (sim_option(argc, argv, "batch") != NULL);
+    int fused_selected = (sim_option(argc, argv, "fused") != NULL);
+    double atol=1.0e-8, rtol=1.0e-10;
+    dopri_t dopri;
+    double tol=1.0e-6;
+    romberg_t romberg_vel, romberg_pos;
+    int gauss_order=8;
+    unsigned long gauss_panels=16;
+
+    printf("\nUse: simtrain [threads] [dt] [duration] [integrator is 0=Riemann, 1=Trap, 2=Simpsons, 3=RK4, 4=Dormand-Prince, 5=Romberg, 6=Gauss-Legendre]\n");
+    printf("     options: --batch to evaluate the oracle in SIMD blocks, --fused for one velocity+position sweep\n");
+    printf("              --atol=tolerance --rtol=tolerance for Dormand-Prince (default 1e-8 and 1e-10)\n");
+    printf("              --tol=tolerance for Romberg (default 1e-6)\n");
+    printf("              --order=nodes --panels=count for Gauss-Legendre (default 8 and 16)\n");
+    printf("              --schedule=static|dynamic|guided --chunk=size to split the steps across threads\n");
+
+    if(posc == 2)
     {
-        sscanf(argv[1], "%d", &thread_count);
+        sscanf(posv[1], "%d", &thread_count);
     }
-    else if(argc == 3) 
+    else if(posc == 3) 
     {
-        sscanf(argv[1], "%d", &thread_count);
-        sscanf(argv[2], "%lf", &dt);
+        sscanf(posv[1], "%d", &thread_count);
+        sscanf(posv[2], "%lf", &dt);
     }
-    else if(argc == 4) 
+    else if(posc == 4) 
     {
-        sscanf(argv[1], "%d", &thread_count);
-        sscanf(argv[2], "%lf", &dt);
-        sscanf(argv[3], "%lf", &duration);
+        sscanf(posv[1], "%d", &thread_count);
+        sscanf(posv[2], "%lf", &dt);
+        sscanf(posv[3], "%lf", &duration);
     }
-    else if(argc == 5) 
+    else if(posc == 5) 
     {
-        sscanf(argv[1], "%d", &thread_count);
-        sscanf(argv[2], "%lf", &dt);
-        sscanf(argv[3], "%lf", &duration);
-        sscanf(argv[4], "%d", &integrator_selected);
+        sscanf(posv[1], "%d", &thread_count);
+        sscanf(posv[2], "%lf", &dt);
+        sscanf(posv[3], "%lf", &duration);
+        sscanf(posv[4], "%d", &integrator_selected);
     }
 
+    if(sim_option(argc, argv, "atol")) sscanf(sim_option(argc, argv, "atol"), "%lf", &atol);
+    if(sim_option(argc, argv, "rtol")) sscanf(sim_option(argc, argv, "rtol"), "%lf", &rtol);
+    if(sim_option(argc, argv, "tol")) sscanf(sim_option(argc, argv, "tol"), "%lf", &tol);
+    if(sim_option(argc, argv, "order")) sscanf(sim_option(argc, argv, "order"), "%d", &gauss_order);
+    if(sim_option(argc, argv, "panels")) sscanf(sim_option(argc, argv, "panels"), "%lu", &gauss_panels);
+
+    if(partition_parse(sim_option(argc, argv, "schedule"), sim_option(argc, argv, "chunk"), &schedule) < 0)
+        exit(-1);
+
     integration_steps = duration / dt;
 
     // determined such that the sine curve is stretched over duration
@@ -104,7 +144,46 @@ void main(int argc, char *argv[])
     time_a = 0.0;
     time_b = duration;
 
-    switch(integrator_selected)
+    // Dormand-Prince adapts its own step to --atol/--rtol, so dt is not used, and integrates velocity and
+    // position together on one thread since each step depends on the last
+    if(integrator_selected == DOPRI5)
+    {
+        Dopri_Train(time_a, time_b, ex3_accel, atol, rtol, &VelStep, &PosStep, &dopri);
+        printf("Dormand-Prince: %lu steps, %lu rejected, %lu evaluations, error estimate vel=%le pos=%le\n",
+               dopri.steps, dopri.rejected, dopri.evaluations, dopri.err_sum[0], dopri.err_sum[1]);
+    }
+
+    // Romberg refines its own trapezoidal grid until --tol is met, reusing every coarser sample, so dt is not used
+    else if(integrator_selected == ROMBERG)
+    {
+        VelStep = Romberg(time_a, time_b, ex3_accel, tol, thread_count, &romberg_vel);
+        PosStep = Romberg(time_a, time_b, ex3_vel, tol, thread_count, &romberg_pos);
+        Romberg_Print("velocity", time_a, time_b, &romberg_vel);
+        Romberg_Print("position", time_a, time_b, &romberg_pos);
+    }
+
+    // Gauss-Legendre uses --order nodes on each of --panels panels, so dt is not used
+    else if(integrator_selected == GAUSS_LEGENDRE)
+    {
+        VelStep = Gauss_Legendre(time_a, time_b, ex3_accel, gauss_order, gauss_panels, thread_count);
+        PosStep = Gauss_Legendre(time_a, time_b, ex3_vel, gauss_order, gauss_panels, thread_count);
+        printf("Gauss-Legendre: order %d on %lu panels, %lu evaluations\n", gauss_order, gauss_panels, 2*gauss_order*gauss_panels);
+    }
+
+    // The fused path integrates only the acceleration, advancing velocity and position together in one sweep
+    else if(fused_selected)
+        Fused_Integrate(integrator_selected, time_a, time_b, integration_steps, ex3_accel, thread_count, &VelStep, &PosStep);
+
+    // The batch path runs the same rules on blocks of oracle samples generated with SIMD
+    else if(batch_selected)
+    {
+        #pragma omp parallel num_threads(thread_count) reduction(+:VelStep)
+        VelStep += Local_Batch(integrator_selected, time_a, time_b, integration_steps, ex3_accel_batch, schedule);
+
+        #pragma omp parallel num_threads(thread_count) reduction(+:PosStep)
+        PosStep += Local_Batch(integrator_selected, time_a, time_b, integration_steps, ex3_vel_batch, schedule);
+    }
+    else switch(integrator_selected)
     {
         case RIEMANN:
             #pragma omp parallel num_threads(thread_count) reduction(+:VelStep)
@@ -168,137 +247,25 @@ void main(int argc, char *argv[])
 
 double Local_Riemann(double a, double b, unsigned long n, double funct(double))
 {
-    double dt, interval_sum=0.0, local_a, local_b, time;
-    int my_rank = omp_get_thread_num();
-    int thread_count = omp_get_num_threads();
-
-    dt = (b-a)/((double)n);
-
-    unsigned long idx, local_n;
-
-    local_n = n / thread_count;
-
-    local_a = a + my_rank*local_n*dt;
-    local_b = local_a + local_n*dt;
-
-
-    for(idx=1; idx <= local_n; idx++)
-    {
-        time = local_a + idx*dt;
-        interval_sum += (funct(time) * dt);
-        //printf("Step for my_rank=%d at time=%lf, f(t)=%lf, sum=%lf\n", my_rank, time, funct(time), interval_sum);
-    }
-
-    //printf("Local Riemann = %lf for my_rank=%d of threads %d with dt=%lf, on a=%lf to b=%lf for %d steps\n",
-    //        interval_sum, my_rank, thread_count, dt, local_a, local_b, local_n);
-
-    return interval_sum;
+    return Local_Rule(RIEMANN, a, b, n, funct, schedule);
 }
 
 
 double Local_Trap(double a, double b, unsigned long n, double funct(double))
 {
-    double dt = (b - a) / n;
-    double local_a, local_b, time, interval_sum;
-    int my_rank = omp_get_thread_num();
-    int thread_count = omp_get_num_threads();
-    unsigned long idx, local_n;
-
-    local_n = n / thread_count;
-
-    local_a = a + my_rank*local_n*dt;
-    local_b = local_a + local_n*dt;
-
-    interval_sum = (funct(local_a) + funct(local_b)) / 2.0;
-
-    for (idx = 1; idx < local_n; idx++)
-    {
-        time = local_a + idx * dt;
-        interval_sum += funct(time);
-    }
-
-    return dt * interval_sum;
+    return Local_Rule(TRAPEZOIDAL, a, b, n, funct, schedule);
 }
 
 
 double Local_Simpson(double a, double b, unsigned long n, double funct(double))
 {
-    double dt = (b - a) / n;
-    double interval_sum = 0.0;
-    double local_a, local_b, time, fx;
-    int my_rank = omp_get_thread_num();
-    int thread_count = omp_get_num_threads();
-    unsigned long idx, local_n;
-
-    local_n = n / thread_count;
-
-    local_a = a + my_rank*local_n*dt;
-    local_b = local_a + local_n*dt;
-
-    for (idx = 1; idx <= local_n; idx++)
-    {
-        time = local_a + idx * dt;
-        fx = funct(time);
-
-        // See https://en.wikipedia.org/wiki/Simpson's_rule for more information
-        //
-        // 1) on the first we evaluate f(a) and on the last we evaluate f(b)
-        // 2) for steps between we alternate between (4/3)f(a+b) and (2/3)f(a+b)
-        // 3) at the end we return h times the weighted sum of all the 1/3, 4/3, 2/3 summation
-        //    terms.
-        //
-        if (idx == 0 || idx == local_n)
-        {
-            interval_sum += fx;
-        }
-
-        // Alternating 4/3 and 2/3 weighting for points between f(a) and f(b)
-        else if (idx % 2 == 1)
-        {
-            interval_sum += 4.0 * fx;
-        }
-        else
-        {
-            interval_sum += 2.0 * fx;
-        }
-    }
-
-    // h=(b-a)/n, sum= [f(a) + f(b)] + (4 or 2)*f(a+b), all multipied by 1/3
-    return dt * interval_sum / 3.0;
+    return Local_Rule(SIMPSON, a, b, n, funct, schedule);
 }
 
 
 double Local_RK4(double a, double b, unsigned long n, double funct(double))
 {
-    double dt = (b - a) / n;
-    double interval_sum = 0.0;
-    double local_a, local_b, time, k1, k2, k3, k4;
-    int my_rank = omp_get_thread_num();
-    int thread_count = omp_get_num_threads();
-    unsigned long idx, local_n;
-
-    local_n = n / thread_count;
-
-    local_a = a + my_rank*local_n*dt;
-    local_b = local_a + local_n*dt;
-
-
-    // March from a to b in n uniform steps
-    for (idx = 1; idx <= local_n; idx++)
-    {
-        time = local_a + idx * dt;
-
-        // RK4 stages: k1..k4 evaluate f at time, time+dt/2, time+dt
-        k1 = funct(time);
-        k2 = funct(time + 0.5 * dt);
-        k3 = funct(time + 0.5 * dt);
-        k4 = funct(time + dt);
-
-        // Update the integral using RK4 combination
-        interval_sum += k1 + 2.0*k2 + 2.0*k3 + k4;
-    }
-
-    return dt * interval_sum / 6.0;
+    return Local_Rule(RK4, a, b, n, funct, schedule);
 }
 
 
@@ -313,3 +280,28 @@ double ex3_vel(double time)
 {
     return ((-cos(time/tscale)+1)*vscale);
 }
+
+
+// n must be at most BATCH_SIZE, as it is from Local_Batch
+void ex3_accel_batch(double t0, double dt, unsigned long n, double *out)
+{
+    double cos_out[BATCH_SIZE];
+    unsigned long k;
+
+    sincos_batch(t0/tscale, dt/tscale, n, out, cos_out);
+
+    for(k=0; k < n; k++)
+        out[k] *= ascale;
+}
+
+
+void ex3_vel_batch(double t0, double dt, unsigned long n, double *out)
+{
+    double sin_out[BATCH_SIZE];
+    unsigned long k;
+
+    sincos_batch(t0/tscale, dt/tscale, n, sin_out, out);
+
+    for(k=0; k < n; k++)
+        out[k] = (-out[k]+1)*vscale;
+}
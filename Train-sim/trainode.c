@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "dopri5.h"
+#include "trainode.h"
+
+// State-dependent train dynamics - see trainode.h
+
+
+train_model_t *train_model_init(train_model_t *m, double accel(double))
+{
+    memset(m, 0, sizeof(train_model_t));
+    m->accel = accel;
+    m->accel_scale = 1.0;
+    m->mass = 1.0;
+
+    return m;
+}
+
+
+int train_model_add(train_model_t *m, train_force *force)
+{
+    if(m->nforces == TRAIN_MAX_FORCES)
+    {
+        printf("Train model already has %d force terms\n", TRAIN_MAX_FORCES);
+        return -1;
+    }
+
+    m->force[m->nforces++] = force;
+    return 0;
+}
+
+
+double train_force_davis(const train_model_t *m, double t, const double *y)
+{
+    double v = y[0];
+
+    // at rest, the breakaway resistance
+    return (v > 0.0) ? -(m->davis_a + m->davis_b*v + m->davis_c*v*v) : -m->davis_a;
+}
+
+
+double train_force_grade(const train_model_t *m, double t, const double *y)
+{
+    double grade, curvature;
+
+    track_at(m->track, y[1], &grade, &curvature);
+    return -TRAIN_GRAVITY * grade;
+}
+
+
+double train_force_curve(const train_model_t *m, double t, const double *y)
+{
+    double grade, curvature;
+
+    track_at(m->track, y[1], &grade, &curvature);
+    return -TRAIN_GRAVITY * m->curve_coeff * curvature;
+}
+
+
+void train_ode_rhs(double t, const double *y, double *dydt, void *ctx)
+{
+    const train_model_t *m = ctx;
+    double command = m->accel_scale * m->accel(t), accel = command, rest[DOPRI_MAX_DIM];
+    int k;
+
+    // a step that overshot zero leaves the train at rest, not reversing - the force terms see it stopped too
+    if(y[0] < 0.0)
+    {
+        for(k=0; k < train_model_dim(m); k++) rest[k] = y[k];
+        rest[0] = 0.0;
+        y = rest;
+    }
+
+    for(k=0; k < m->nforces; k++)
+        accel += m->force[k](m, t, y);
+
+    // stopped, and held by the brakes rather than pushed backward
+    if((y[0] <= 0.0) && (accel < 0.0))
+        accel = 0.0;
+
+    dydt[0] = accel;
+    dydt[1] = y[0];
+
+    if(m->energy)
+        dydt[2] = (command > 0.0) && (y[0] > 0.0) ? m->mass * command * y[0] : 0.0;
+}
+
+
+void train_ode_project(double *y, void *ctx)
+{
+    if(y[0] < 0.0)
+        y[0] = 0.0;
+}
+
+
+void track_at(const track_t *track, double x, double *grade, double *curvature)
+{
+    double s = x / track->spacing, frac;
+    int idx;
+
+    if(s <= 0.0)
+    {
+        *grade = track->grade[0];
+        *curvature = track->curvature[0];
+        return;
+    }
+
+    idx = (int)s;
+    if(idx >= track->count-1)
+    {
+        *grade = track->grade[track->count-1];
+        *curvature = track->curvature[track->count-1];
+        return;
+    }
+
+    frac = s - (double)idx;
+    *grade = track->grade[idx] + (track->grade[idx+1] - track->grade[idx]) * frac;
+    *curvature = track->curvature[idx] + (track->curvature[idx+1] - track->curvature[idx]) * frac;
+}
+
+
+int track_load(const char *file, double spacing, track_t *track)
+{
+    FILE *fp = fopen(file, "r");
+    char line[256];
+    double grade, radius;
+    int capacity = 1024;
+
+    if(fp == NULL)
+    {
+        printf("Could not open track file %s\n", file);
+        return -1;
+    }
+
+    track->count = 0;
+    track->spacing = spacing;
+    track->grade = malloc(sizeof(double) * capacity);
+    track->curvature = malloc(sizeof(double) * capacity);
+
+    while(fgets(line, sizeof(line), fp) != NULL)
+    {
+        // skip headers and blank lines
+        if(sscanf(line, "%lf,%lf", &grade, &radius) != 2)
+            continue;
+
+        if(track->count == capacity)
+        {
+            double *g = realloc(track->grade, sizeof(double) * 2 * capacity);
+            if(g != NULL) track->grade = g;
+            double *c = realloc(track->curvature, sizeof(double) * 2 * capacity);
+            if(c != NULL) track->curvature = c;
+
+            if((g == NULL) || (c == NULL))
+                track->count = -1;
+            else
+                capacity *= 2;
+        }
+
+        if((track->grade == NULL) || (track->curvature == NULL) || (track->count < 0))
+        {
+            printf("Could not allocate track of %d samples\n", 2 * capacity);
+            fclose(fp);
+            track_free(track);
+            return -1;
+        }
+
+        track->grade[track->count] = grade;
+        track->curvature[track->count] = (radius != 0.0) ? 1.0 / fabs(radius) : 0.0;
+        track->count++;
+    }
+
+    fclose(fp);
+
+    if((track->count == 0) || (spacing <= 0.0))
+    {
+        printf("Track file %s has no grade,radius samples, or spacing %lf is not positive\n", file, spacing);
+        track_free(track);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+void track_free(track_t *track)
+{
+    free(track->grade);
+    free(track->curvature);
+    track->grade = track->curvature = NULL;
+    track->count = 0;
+}
@@ -0,0 +1,97 @@
+#ifndef TRAINODE_H
+#define TRAINODE_H
+
+// State-dependent train dynamics
+//
+// The drivers' rolling_deceleration is one constant added or subtracted in faccel.  Here the train is a state
+// vector y = (velocity, position[, energy]) driven by the profile's commanded acceleration and a list of force
+// terms, each a function of time and state giving an acceleration (force per unit mass, m/s^2):
+//
+//     dv/dt = scale*accel(t) + sum of force terms(t, y)
+//     dx/dt = v
+//     dE/dt = mass * max(scale*accel(t), 0) * v      with energy on, the tractive work in J
+//
+// The built-in terms are
+//
+//     train_force_davis   -(A + B*v + C*v^2) against the motion - rolling, flange and aerodynamic resistance
+//     train_force_grade   -g*grade(x) from the track table, uphill positive
+//     train_force_curve   -g*curve_coeff/R(x) against the motion - Rockl-style curve resistance, where
+//                         curve_coeff of 0.65 m is 650/R N/kN
+//
+// and any other term with the same signature can be added.  Resistance and brakes can stop the train but never
+// run it backward, so once stopped it stays at rest until the net acceleration is positive again.  At rest the
+// resistance terms give their value as the train starts to move (A for Davis), so the train only starts once the
+// command overcomes them - without that breakaway resistance a train at rest with a small command would start,
+// meet the resistance, stop and start again, and an adaptive integrator crawls through the chatter.
+//
+// train_ode_rhs() is an ode_rhs (see dopri5.h) with ctx pointing to the train_model_t, so the model runs under
+// Dormand-Prince, Parareal or any other integrator of ode_rhs, with train_ode_project after each fixed step.  It
+// loops over at most TRAIN_MAX_FORCES function pointers with no allocation, and the track look-ups are O(1) on a
+// uniform grid of positions.
+//
+#define TRAIN_MAX_FORCES (8)
+
+// Track properties every spacing meters from position 0, linearly interpolated, holding the last sample past the
+// end and the first before position 0
+typedef struct
+{
+    int count;
+    double spacing;
+    double *grade;                          // rise over run, positive uphill
+    double *curvature;                      // 1/R in 1/m, 0.0 on straight track
+} track_t;
+
+typedef struct train_model train_model_t;
+
+// Acceleration contributed by a force term at time t and state y
+typedef double train_force(const train_model_t *m, double t, const double *y);
+
+struct train_model
+{
+    double (*accel)(double);                // commanded acceleration from the profile
+    double accel_scale;                     // and its scale, 1.0 unless the profile is scaled per train
+
+    double davis_a, davis_b, davis_c;       // per unit mass, m/s^2, 1/s, 1/m
+    const track_t *track;                   // for the grade and curve terms
+    double curve_coeff;                     // m
+
+    int energy;                             // integrate tractive energy as y[2]
+    double mass;                            // kg, for the energy
+
+    int nforces;
+    train_force *force[TRAIN_MAX_FORCES];
+};
+
+#define TRAIN_GRAVITY (9.81)
+
+// Model driven by accel at scale 1.0 with no force terms, no energy and unit mass - returns the model for chaining
+train_model_t *train_model_init(train_model_t *m, double accel(double));
+
+// Add a force term - returns 0, or -1 if there are already TRAIN_MAX_FORCES
+int train_model_add(train_model_t *m, train_force *force);
+
+// Number of equations, 2 or 3 with energy
+static inline int train_model_dim(const train_model_t *m)
+{
+    return m->energy ? 3 : 2;
+}
+
+double train_force_davis(const train_model_t *m, double t, const double *y);
+double train_force_grade(const train_model_t *m, double t, const double *y);
+double train_force_curve(const train_model_t *m, double t, const double *y);
+
+void train_ode_rhs(double t, const double *y, double *dydt, void *ctx);
+
+// An ode_project (see parareal.h) for fixed step integrators - a step braking to a stop can overshoot to a small
+// negative velocity, which train_ode_rhs treats as rest, and this puts it back to zero
+void train_ode_project(double *y, void *ctx);
+
+// Grade and curvature at position x
+void track_at(const track_t *track, double x, double *grade, double *curvature);
+
+// Load a track from a CSV file of "grade,radius" lines spacing meters apart, radius in m and 0 for straight track
+// - returns 0, or -1 with a message printed
+int track_load(const char *file, double spacing, track_t *track);
+void track_free(track_t *track);
+
+#endif